@@ -0,0 +1,342 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// BITBASES
+//
+// Author: Stewart Tunbridge, Pi Micros
+// Email:  stewarttunbridge@gmail.com
+// Copyright (c) 2025 Stewart Tunbridge, Pi Micros
+//
+// Win / draw for every KPK, KRK and KQK position, one bit each, built in memory by retrograde
+// analysis when the programme starts.
+//
+// The strong side (the one with the piece) is always White here, the caller turns the board round
+// if need be. A position is a win if the strong side can force mate, else a draw.
+//
+// Each position starts unknown. Passes are made over all the positions until nothing changes:
+//   - strong to move: a win if any move reaches a win. A draw if all moves reach draws
+//   - weak to move: a draw if any move reaches a draw (or takes the piece). A win if all moves reach
+//     wins. Mated is a win, stalemate a draw
+// What's still unknown at the end can't be forced, so it's a draw. Each pass is split between
+// threads by index range. Results only ever go from unknown to known, so it doesn't matter if a
+// thread sees another's result from this pass or the last.
+//
+// Symmetry keeps them small: a pawn is kept on files a-d, and a Rook or Queen's strong King in the
+// a1-d1-d4 triangle. KPK is 24KB, KRK and KQK 10KB each. A pawn only crowns to a Queen, as MovePiece
+// does.
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef enum {bbKQK, bbKRK, bbKPK, bbTables} _BitbaseTable;
+
+typedef enum {brUnknown, brWin, brDraw, brIllegal} _BitbaseResult;
+
+typedef struct
+  {
+    int Size;   // positions
+    unsigned char *Result;   // _BitbaseResult for each, while it's built
+    unsigned char *Bits;   // 1 => win
+  } _Bitbase;
+
+_Bitbase Bitbases [bbTables];
+bool BitbaseReady = false;
+int BitbaseTime;   // ms to build
+
+// Squares are y * 8 + x
+#define bbX(s) ((s) & 7)
+#define bbY(s) ((s) >> 3)
+#define bbSquare(x,y) ((y) * 8 + (x))
+
+int BitbaseDirX [] = {0, 1, 1, 1, 0, -1, -1, -1};   // Rook's are the even ones
+int BitbaseDirY [] = {1, 1, 0, -1, -1, -1, 0, 1};
+
+// The strong King in the a1-d1-d4 triangle. -1 => not in it
+int BitbaseTriangle [64] =
+  { 0,  1,  2,  3, -1, -1, -1, -1,
+   -1,  4,  5,  6, -1, -1, -1, -1,
+   -1, -1,  7,  8, -1, -1, -1, -1,
+   -1, -1, -1,  9, -1, -1, -1, -1,
+   -1, -1, -1, -1, -1, -1, -1, -1,
+   -1, -1, -1, -1, -1, -1, -1, -1,
+   -1, -1, -1, -1, -1, -1, -1, -1,
+   -1, -1, -1, -1, -1, -1, -1, -1};
+int BitbaseTriangleSquare [10] = {0, 1, 2, 3, 9, 10, 11, 18, 19, 27};
+
+bool BitbaseNear (int a, int b)
+  {
+    return Abs (bbX (a) - bbX (b)) <= 1 && Abs (bbY (a) - bbY (b)) <= 1;
+  }
+
+// Index of a position. Moves Pce's table to the symmetry it's kept in
+
+int BitbaseIndex (_BitbaseTable Table, bool StrongToMove, int Strong, int Weak, int Pce)
+  {
+    int Mirror;
+    //
+    if (Table == bbKPK)
+      {
+        if (bbX (Pce) > 3)   // a-d files
+          {
+            Strong ^= 7;
+            Weak ^= 7;
+            Pce ^= 7;
+          }
+        return (((!StrongToMove * 24 + (bbY (Pce) - 1) * 4 + bbX (Pce)) * 64) + Strong) * 64 + Weak;
+      }
+    Mirror = 0;
+    if (bbX (Strong) > 3)
+      Mirror ^= 7;
+    if (bbY (Strong) > 3)
+      Mirror ^= 0x38;
+    Strong ^= Mirror;
+    Weak ^= Mirror;
+    Pce ^= Mirror;
+    if (bbY (Strong) > bbX (Strong))   // flip on the a1-h8 diagonal
+      {
+        Strong = bbSquare (bbY (Strong), bbX (Strong));
+        Weak = bbSquare (bbY (Weak), bbX (Weak));
+        Pce = bbSquare (bbY (Pce), bbX (Pce));
+      }
+    return ((!StrongToMove * 10 + BitbaseTriangle [Strong]) * 64 + Weak) * 64 + Pce;
+  }
+
+void BitbasePosition (_BitbaseTable Table, int Index, bool *StrongToMove, int *Strong, int *Weak, int *Pce)
+  {
+    if (Table == bbKPK)
+      {
+        *Weak = Index & 63;
+        *Strong = (Index >> 6) & 63;
+        Index >>= 12;
+        *Pce = bbSquare ((Index % 24) & 3, (Index % 24) / 4 + 1);
+        *StrongToMove = Index < 24;
+      }
+    else
+      {
+        *Pce = Index & 63;
+        *Weak = (Index >> 6) & 63;
+        Index >>= 12;
+        *Strong = BitbaseTriangleSquare [Index % 10];
+        *StrongToMove = Index < 10;
+      }
+  }
+
+_BitbaseResult BitbaseGet (_BitbaseTable Table, bool StrongToMove, int Strong, int Weak, int Pce)
+  {
+    return (_BitbaseResult) __atomic_load_n (&Bitbases [Table].Result [BitbaseIndex (Table, StrongToMove, Strong, Weak, Pce)], __ATOMIC_RELAXED);
+  }
+
+// True if the piece on Pce attacks At. The strong King on Strong may block it
+
+bool BitbaseAttacks (_BitbaseTable Table, int Pce, int At, int Strong)
+  {
+    int dx, dy, s;
+    //
+    dx = bbX (At) - bbX (Pce);
+    dy = bbY (At) - bbY (Pce);
+    if (Table == bbKPK)
+      return dy == 1 && Abs (dx) == 1;
+    if (dx == 0 && dy == 0)
+      return false;
+    if (dx != 0 && dy != 0 && (Table == bbKRK || Abs (dx) != Abs (dy)))
+      return false;
+    dx = (dx > 0) - (dx < 0);
+    dy = (dy > 0) - (dy < 0);
+    for (s = Pce + dy * 8 + dx; s != At; s += dy * 8 + dx)
+      if (s == Strong)
+        return false;
+    return true;
+  }
+
+// Work out one position from the ones it moves to
+
+_BitbaseResult BitbaseEvaluate (_BitbaseTable Table, int Index)
+  {
+    bool StrongToMove, Unknown;
+    int Strong, Weak, Pce, d, x, y, To, Moves;
+    _BitbaseResult r;
+    //
+    BitbasePosition (Table, Index, &StrongToMove, &Strong, &Weak, &Pce);
+    Unknown = false;
+    if (StrongToMove)
+      {
+        // King
+        for (d = 0; d < 8; d++)
+          {
+            x = bbX (Strong) + BitbaseDirX [d];
+            y = bbY (Strong) + BitbaseDirY [d];
+            To = bbSquare (x, y);
+            if (x < 0 || x > 7 || y < 0 || y > 7 || To == Pce || BitbaseNear (To, Weak))
+              continue;
+            r = BitbaseGet (Table, false, To, Weak, Pce);
+            if (r == brWin)
+              return brWin;
+            Unknown |= (r == brUnknown);
+          }
+        // Pawn
+        if (Table == bbKPK)
+          {
+            To = Pce + 8;
+            if (To == Strong || To == Weak)
+              return Unknown ? brUnknown : brDraw;
+            if (bbY (To) == 7)
+              r = BitbaseGet (bbKQK, false, Strong, Weak, To);   // crowned
+            else
+              r = BitbaseGet (Table, false, Strong, Weak, To);
+            if (r == brWin)
+              return brWin;
+            Unknown |= (r == brUnknown);
+            To += 8;
+            if (bbY (Pce) == 1 && To != Strong && To != Weak)   // double step
+              {
+                r = BitbaseGet (Table, false, Strong, Weak, To);
+                if (r == brWin)
+                  return brWin;
+                Unknown |= (r == brUnknown);
+              }
+            return Unknown ? brUnknown : brDraw;
+          }
+        // Rook or Queen
+        for (d = 0; d < 8; d += (Table == bbKRK) ? 2 : 1)
+          for (x = bbX (Pce) + BitbaseDirX [d], y = bbY (Pce) + BitbaseDirY [d]; x >= 0 && x <= 7 && y >= 0 && y <= 7; x += BitbaseDirX [d], y += BitbaseDirY [d])
+            {
+              To = bbSquare (x, y);
+              if (To == Strong || To == Weak)
+                break;
+              r = BitbaseGet (Table, false, Strong, Weak, To);
+              if (r == brWin)
+                return brWin;
+              Unknown |= (r == brUnknown);
+            }
+        return Unknown ? brUnknown : brDraw;
+      }
+    // Weak King to move
+    Moves = 0;
+    for (d = 0; d < 8; d++)
+      {
+        x = bbX (Weak) + BitbaseDirX [d];
+        y = bbY (Weak) + BitbaseDirY [d];
+        To = bbSquare (x, y);
+        if (x < 0 || x > 7 || y < 0 || y > 7 || BitbaseNear (To, Strong))
+          continue;
+        if (To == Pce)   // takes it, and it isn't guarded
+          return brDraw;
+        if (BitbaseAttacks (Table, Pce, To, Strong))
+          continue;
+        Moves++;
+        r = BitbaseGet (Table, true, Strong, To, Pce);
+        if (r == brDraw)
+          return brDraw;
+        Unknown |= (r == brUnknown);
+      }
+    if (Moves == 0)   // mate or stalemate
+      return BitbaseAttacks (Table, Pce, Weak, Strong) ? brWin : brDraw;
+    return Unknown ? brUnknown : brWin;
+  }
+
+// One thread's share of a pass
+
+typedef struct
+  {
+    _BitbaseTable Table;
+    int From, To;
+    bool Init;   // first pass: mark the illegal positions
+    int Changed;
+  } _BitbaseSlice;
+
+void BitbasePass (void *Param)
+  {
+    _BitbaseSlice *Slice;
+    _BitbaseResult r;
+    bool StrongToMove;
+    int i, Strong, Weak, Pce;
+    unsigned char *Result;
+    //
+    Slice = (_BitbaseSlice *) Param;
+    Result = Bitbases [Slice->Table].Result;
+    Slice->Changed = 0;
+    for (i = Slice->From; i < Slice->To; i++)
+      if (Slice->Init)
+        {
+          BitbasePosition (Slice->Table, i, &StrongToMove, &Strong, &Weak, &Pce);
+          if (Strong == Weak || Strong == Pce || Weak == Pce || BitbaseNear (Strong, Weak)
+              || (StrongToMove && BitbaseAttacks (Slice->Table, Pce, Weak, Strong))
+              || BitbaseIndex (Slice->Table, StrongToMove, Strong, Weak, Pce) != i)   // the same as another by symmetry
+            Result [i] = brIllegal;
+          else
+            Result [i] = brUnknown;
+        }
+      else if (Result [i] == brUnknown)
+        {
+          r = BitbaseEvaluate (Slice->Table, i);
+          if (r != brUnknown)
+            {
+              __atomic_store_n (&Result [i], (unsigned char) r, __ATOMIC_RELAXED);
+              Slice->Changed++;
+            }
+        }
+  }
+
+bool BitbaseBuild (_BitbaseTable Table, int Threads)
+  {
+    _BitbaseSlice Slices [256];
+    _Bitbase *b;
+    int i, Changed, Pass;
+    //
+    b = &Bitbases [Table];
+    b->Size = (Table == bbKPK) ? 2 * 24 * 64 * 64 : 2 * 10 * 64 * 64;
+    b->Result = (unsigned char *) malloc (b->Size);
+    b->Bits = (unsigned char *) malloc (b->Size / 8);
+    if (b->Result == NULL || b->Bits == NULL)
+      return false;
+    Threads = Min (Threads, 256);
+    for (i = 0; i < Threads; i++)
+      {
+        Slices [i].Table = Table;
+        Slices [i].From = (longint) b->Size * i / Threads;
+        Slices [i].To = (longint) b->Size * (i + 1) / Threads;
+      }
+    for (Pass = 0; Pass <= 1 || Changed > 0; Pass++)   // pass 0 marks the illegal ones
+      {
+        for (i = 0; i < Threads; i++)
+          Slices [i].Init = (Pass == 0);
+        ThreadsParallel (BitbasePass, Slices, sizeof (_BitbaseSlice), Threads);
+        Changed = 0;
+        for (i = 0; i < Threads; i++)
+          Changed += Slices [i].Changed;
+      }
+    // Pack. What's left unknown is a draw
+    for (i = 0; i < b->Size / 8; i++)
+      b->Bits [i] = 0;
+    for (i = 0; i < b->Size; i++)
+      if (b->Result [i] == brWin)
+        b->Bits [i >> 3] |= 1 << (i & 7);
+    return true;
+  }
+
+// BitbaseInit: Build the bitbases. KQK first, KPK needs it for a pawn crowning
+
+bool BitbaseInit (void)
+  {
+    int t;
+    bool OK;
+    //
+    BitbaseTime = ClockMS ();
+    OK = BitbaseBuild (bbKQK, ThreadCount ()) && BitbaseBuild (bbKRK, ThreadCount ()) && BitbaseBuild (bbKPK, ThreadCount ());
+    for (t = 0; t < bbTables; t++)
+      {
+        free (Bitbases [t].Result);
+        Bitbases [t].Result = NULL;
+      }
+    BitbaseTime = ClockMS () - BitbaseTime;
+    BitbaseReady = OK;
+    return OK;
+  }
+
+// BitbaseWin: True if the strong side (White) wins
+
+bool BitbaseWin (_BitbaseTable Table, bool StrongToMove, int Strong, int Weak, int Pce)
+  {
+    int i;
+    //
+    i = BitbaseIndex (Table, StrongToMove, Strong, Weak, Pce);
+    return (Bitbases [Table].Bits [i >> 3] >> (i & 7)) & 1;
+  }
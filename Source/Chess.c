@@ -18,16 +18,19 @@ typedef enum {pEmpty, pKing, pQueen, pRook, pBishop, pKnight, pPawn, pWhite = 0x
   // Bits 8..31 Move ID: 0 => never moved.  (needed for castling & en passant
 
 typedef _Piece _Board [8][8] ;   // Board [x][y]
-_Board Board;   // This is THE BOARD
-int MoveID;   // ID incremented every move
-_Coord MoveForbidenFrom = {-1, -1};
-_Coord MoveForbidenTo = {-1, -1};
+
+// The position and search state are per thread, so other threads can work on their own Board
+
+thread_local _Board Board;   // This is THE BOARD
+thread_local int MoveID;   // ID incremented every move
+thread_local _Coord MoveForbidenFrom = {-1, -1};
+thread_local _Coord MoveForbidenTo = {-1, -1};
 
 bool PlayerWhite;
 
 typedef enum {aPiecesOnly, aMoves, aExtend, aDefend} _Analysis;
 
-int DepthPlay = 3;
+thread_local int DepthPlay = 3;
 
 _Analysis Analysis = aMoves;
 int AnalysisScorePiece = 1000;   // Value of a Pawn
@@ -41,6 +44,7 @@ int Randomize = 0;
 
 #define Piece(p)       (_Piece) (p & (pWhite-1))
 #define PieceWhite(p)  ((p&pWhite) != 0)
+#define PieceColour(p) (_Piece) (p & (pWhite + pWhite - 1))   // Piece and colour, no flags
 #define PieceFrom(BasePiece,White) ((_Piece)(White ? (BasePiece | pWhite) : BasePiece))
 
 bool InCheck (bool PlayWhite);
@@ -53,7 +57,9 @@ bool InCheck (bool PlayWhite);
 
 _Piece BoardStart [8] = {pRook, pKnight, pBishop, pQueen, pKing, pBishop, pKnight, pRook};
 
-void BoardInit ()
+// BoardReset: The starting position. BoardInit also seeds the random numbers, so threads use this
+
+void BoardReset ()
   {
     int x, y;
     //
@@ -70,6 +76,11 @@ void BoardInit ()
           Board [x][y] = BoardStart [x];
         else
           Board [x][y] = pEmpty;
+  }
+
+void BoardInit ()
+  {
+    BoardReset ();
     srand (time (NULL));   // Initialize random number generator
   }
 
@@ -178,6 +189,8 @@ void GetPieceMoves (_Coord From, _Coord *Res, _Analysis Analysis = aMoves)   //
                     p_ = PieceFrom (pRook, PieceWhite (FromPce));   // corresponding Rook for the castle: pRook, Colour, no moves
                     if (Piece (Board [(From.x + To.x) / 2][From.y]) != pEmpty)   // passing square must be empty
                       Bad = true;
+                    else if (Piece (ToPce) != pEmpty)   // and the destination
+                      Bad = true;
                     else
                       if (Index == 0)   // Kingside castle
                         {
@@ -235,6 +248,10 @@ void GetPieceMoves (_Coord From, _Coord *Res, _Analysis Analysis = aMoves)   //
 #define MAXINT (int)(((unsigned int) -1)>>1)
 #define MININT (-MAXINT)   // I know this is rong, but it prevents overflow when negating. Was (~MAXINT)
 
+#define MATE (MAXINT - 1000)   // Score for giving mate now. Mate in n plies scores MATE - n
+#define ScoreMate(s) (Abs (s) >= MATE - 500)   // Score is a mate, for or against
+#define ScoreMateMoves(s) ((MATE - Abs (s) + 1) / 2)   // Moves to mate, 0 => mated now
+
 #define iSqr(i) ((i)*(i))
 
 //int BoardScoreWhite = 0;
@@ -350,19 +367,82 @@ int BoardScore (bool PlayWhite)
   }
 
 
+// BoardFeatures: The counts BoardScore multiplies its weights by, for tuning the weights
+//
+// Counts are for PlayWhite less the opponent. With the same weights
+//   Pieces [p] * PieceValue [p] + Moves * AnalysisScoreMove
+//   + (Direct [p] * AnalysisScoreAttack + Indirect [p] * AnalysisScoreAttackInd) * PieceValue [p] * AnalysisScorePiece / 1000000
+// summed over p gives BoardScore, less rounding and Randomize.
+
+typedef struct
+  {
+    short Moves;   // moves into a new square
+    signed char Pieces [7];   // by piece type
+    signed char Direct [7];   // pieces attacked / defended, by type of piece attacked
+    signed char Indirect [7];   // " through another piece
+  } _Features;
+
+_Features FeaturesNone;   // all zero
+
+void BoardFeatures (bool PlayWhite, _Features *Features)
+  {
+    _Coord p1;
+    _Piece p, p_;
+    _Coord Moves [64], *m;
+    int d, d_;
+    int Sign;
+    bool Direct;
+    //
+    *Features = FeaturesNone;
+    for (p1.y = 0; p1.y < 8; p1.y++)
+      for (p1.x = 0; p1.x < 8; p1.x++)
+        {
+          p = (_Piece) Board [p1.x][p1.y];
+          if (Piece (p) != pEmpty)
+            {
+              Sign = (PieceWhite (p) == PlayWhite) ? 1 : -1;
+              Features->Pieces [Piece (p)] += Sign;
+              if (Analysis > aPiecesOnly)
+                {
+                  GetPieceMoves (p1, Moves, Analysis);
+                  m = Moves;
+                  d = MAXINT;
+                  while (m->x >= 0)
+                    {
+                      d_ = Abs (m->x - p1.x) + Abs (m->y - p1.y);
+                      if (d_ <= d)
+                        Direct = true;
+                      d = d_;
+                      p_ = Piece (Board [m->x][m->y]);
+                      if (Direct)
+                        Features->Moves += Sign;
+                      if (p_ != pEmpty)
+                        {
+                          if (Direct)
+                            Features->Direct [p_] += Sign;
+                          else
+                            Features->Indirect [p_] += Sign;
+                          Direct = false;
+                          d = 0;
+                        }
+                      m++;
+                    }
+                }
+            }
+        }
+  }
+
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 //
-// BestMove: Calculate best move recursively
+// MovePiece: Move a piece allowing for special moves
 //
-// Returns Score of best move
 
 typedef enum {smNone, smCrown, smCastle, smEnPassant} _SpecialMove;
 
 int LastRow [] = {0, 7};
 int PawnSkipRow [] = {5, 2};   // Row missed when pawns start with a double
 
-// Move a piece allowing for special moves
-
 _SpecialMove MovePiece (_Coord From, _Coord To)
   {
     _SpecialMove Res;
@@ -463,61 +543,751 @@ void UnmovePiece (_Coord From, _Coord To, _Piece OldFrom, _Piece OldTo, _Special
     //BoardScoreWhiteCheck (false);//####
   }
 
-longint MovesConsidered;
-_Coord BestA [DepthMax], BestB [DepthMax];
-//_Coord BestA_ [DepthMax], BestB_ [DepthMax];   // copy best move sequence
 
-int BestMove (bool PlayWhite, int Depth)
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// GetLegalMoves: Return all strictly legal moves for the player
+//
+// The King, the pieces pinned to it and the pieces checking it are found once. Then
+//   - the King may not move to an attacked square, or castle out of, through or into check
+//   - a pinned piece may only move along its pin
+//   - in check, other pieces may only take the checker or block it. In double check only the King moves
+// En passant can uncover a check along the rank so is tried on the board.
+
+typedef struct
   {
-    _Coord Moves [64], *m;
-    _Piece p, p_;
-    _Coord From;
+    _Coord From, To;
+  } _Move;
+
+#define MovesMax 256
+
+typedef unsigned long long _Squares;   // One bit per square, bit y*8 + x
+#define Square(x,y) ((_Squares) 1 << ((y) * 8 + (x)))
+
+#define OnBoard(x,y) ((unsigned) (x) < 8 && (unsigned) (y) < 8)
+
+// True if square At is attacked by ByWhite's pieces
+
+bool SquareAttacked (_Coord At, bool ByWhite)
+  {
+    _Coord *Dir, To;
+    _Piece p;
+    int y;
+    //
+    // Pawns
+    y = At.y + (ByWhite ? -1 : 1);
+    if (OnBoard (0, y))
+      {
+        if (At.x > 0 && PieceColour (Board [At.x - 1][y]) == PieceFrom (pPawn, ByWhite))
+          return true;
+        if (At.x < 7 && PieceColour (Board [At.x + 1][y]) == PieceFrom (pPawn, ByWhite))
+          return true;
+      }
+    // Knights
+    for (Dir = PieceMovesKnight; Dir->x != End; Dir++)
+      if (OnBoard (At.x + Dir->x, At.y + Dir->y) && PieceColour (Board [At.x + Dir->x][At.y + Dir->y]) == PieceFrom (pKnight, ByWhite))
+        return true;
+    // King and sliders
+    for (Dir = PieceMovesAllDir; Dir->x != End; Dir++)
+      {
+        To.x = At.x + Dir->x;
+        To.y = At.y + Dir->y;
+        if (OnBoard (To.x, To.y) && PieceColour (Board [To.x][To.y]) == PieceFrom (pKing, ByWhite))
+          return true;
+        while (OnBoard (To.x, To.y))
+          {
+            p = Board [To.x][To.y];
+            if (Piece (p) != pEmpty)
+              {
+                if (PieceWhite (p) == ByWhite)
+                  if (Piece (p) == pQueen || Piece (p) == ((Dir->x == 0 || Dir->y == 0) ? pRook : pBishop))
+                    return true;
+                break;
+              }
+            To.x += Dir->x;
+            To.y += Dir->y;
+          }
+      }
+    return false;
+  }
+
+// Find the player's King. Returns false if there isn't one
+
+bool FindKing (bool PlayWhite, _Coord *King)
+  {
+    for (King->y = 0; King->y < 8; King->y++)
+      for (King->x = 0; King->x < 8; King->x++)
+        if (PieceColour (Board [King->x][King->y]) == PieceFrom (pKing, PlayWhite))
+          return true;
+    return false;
+  }
+
+// Moves are put in Res. Returns how many. Checkers is set to the number of pieces giving check
+
+int GetLegalMoves (bool PlayWhite, _Move *Res, int *Checkers)
+  {
+    _Coord King, From, To, *Dir, *m;
+    _Coord Moves [64];
+    _Squares Evasions, Pinned, PinRay [64], Ray;
+    _Piece p, Pinner, OldTo;
     _SpecialMove sm;
-    int Score;
-    int BestScore;
-    int MovesAvailable;
+    int n, y;
+    bool OK;
     //
-    BestScore = MININT;
+    n = 0;
+    *Checkers = 0;
+    Evasions = ~(_Squares) 0;
+    Pinned = 0;
+    if (FindKing (PlayWhite, &King))
+      {
+        // Checks by pawns and knights
+        y = King.y + (PlayWhite ? 1 : -1);
+        for (To.x = King.x - 1; To.x <= King.x + 1; To.x += 2)
+          if (OnBoard (To.x, y) && PieceColour (Board [To.x][y]) == PieceFrom (pPawn, !PlayWhite))
+            {
+              (*Checkers)++;
+              Evasions = Square (To.x, y);
+            }
+        for (Dir = PieceMovesKnight; Dir->x != End; Dir++)
+          if (OnBoard (King.x + Dir->x, King.y + Dir->y) && PieceColour (Board [King.x + Dir->x][King.y + Dir->y]) == PieceFrom (pKnight, !PlayWhite))
+            {
+              (*Checkers)++;
+              Evasions = Square (King.x + Dir->x, King.y + Dir->y);
+            }
+        // Checks and pins along the lines from the King
+        for (Dir = PieceMovesAllDir; Dir->x != End; Dir++)
+          {
+            Pinner = PieceFrom (((Dir->x == 0 || Dir->y == 0) ? pRook : pBishop), !PlayWhite);
+            Ray = 0;
+            From.x = -1;   // my piece on the line
+            To.x = King.x + Dir->x;
+            To.y = King.y + Dir->y;
+            while (OnBoard (To.x, To.y))
+              {
+                Ray |= Square (To.x, To.y);
+                p = (_Piece) PieceColour (Board [To.x][To.y]);
+                if (p != pEmpty)
+                  {
+                    if (PieceWhite (p) == PlayWhite)
+                      {
+                        if (From.x >= 0)   // second of mine, no pin
+                          break;
+                        From = To;
+                      }
+                    else
+                      {
+                        if (p == Pinner || p == PieceFrom (pQueen, !PlayWhite))
+                          if (From.x < 0)   // Check
+                            {
+                              (*Checkers)++;
+                              Evasions = Ray;
+                            }
+                          else   // Pin
+                            {
+                              Pinned |= Square (From.x, From.y);
+                              PinRay [From.y * 8 + From.x] = Ray;
+                            }
+                        break;
+                      }
+                  }
+                To.x += Dir->x;
+                To.y += Dir->y;
+              }
+          }
+        if (*Checkers > 1)
+          Evasions = 0;
+      }
     // Go thru all my pieces and all their moves
-    for (From.y = 0; From.y < 8; From.y++)   // for every square
+    for (From.y = 0; From.y < 8; From.y++)
       for (From.x = 0; From.x < 8; From.x++)
         {
           p = Board [From.x][From.y];
-          if ((Piece (p) != pEmpty) && (PieceWhite (p) == PlayWhite))   // if my piece
+          if ((Piece (p) != pEmpty) && (PieceWhite (p) == PlayWhite))
             {
               GetPieceMoves (From, Moves);
-              m = Moves;
-              while (m->x >= 0)   // for all moves
+              for (m = Moves; m->x >= 0; m++)
                 {
-                  MovesConsidered++;
-                  MovesAvailable++;
-                  p_ = (_Piece) Board [m->x][m->y];   // piece being taken (or Empty)
-                  if (Piece (p_) == pKing)   // This would end in victory
-                    return MAXINT;   // so stop here report the winning move */
-                  sm = MovePiece (From, *m);
-                  if (Depth == DepthPlay)   // Reached the limit of look-ahead
-                    Score = BoardScore (PlayWhite);   // evaluate move
-                  else   // otherwise find the reply move
-                    Score = -BestMove (!PlayWhite, Depth + 1);
-                  if (Score >= BestScore)
+                  if (Piece (p) == pKing)
+                    {
+                      Board [From.x][From.y] = pEmpty;   // so it doesn't block the attack on the square behind it
+                      OK = !SquareAttacked (*m, !PlayWhite);
+                      Board [From.x][From.y] = p;
+                      if (OK && Abs (m->x - From.x) == 2)   // Castle
+                        {
+                          To.x = (From.x + m->x) / 2;
+                          To.y = From.y;
+                          OK = (*Checkers == 0) && !SquareAttacked (To, !PlayWhite);
+                        }
+                    }
+                  else if (Piece (p) == pPawn && m->x != From.x && Piece (Board [m->x][m->y]) == pEmpty)   // En passant
+                    {
+                      OldTo = Board [m->x][m->y];
+                      sm = MovePiece (From, *m);
+                      OK = !SquareAttacked (King, !PlayWhite);
+                      UnmovePiece (From, *m, p, OldTo, sm);
+                    }
+                  else
+                    {
+                      OK = (Evasions & Square (m->x, m->y)) != 0;
+                      if (OK && (Pinned & Square (From.x, From.y)))
+                        OK = (PinRay [From.y * 8 + From.x] & Square (m->x, m->y)) != 0;
+                    }
+                  if (OK)
                     {
-                      BestScore = Score;
-                      BestA [Depth] = From;
-                      BestB [Depth] = *m;
+                      Res [n].From = From;
+                      Res [n].To = *m;
+                      n++;
                     }
-                  UnmovePiece (From, *m, p, p_, sm);
-                  m++;
-                }   // no more moves
+                }
+            }
+        }
+    return n;
+  }
+
+// True if From - To is a legal move for the piece on From
+
+bool MoveLegal (_Coord From, _Coord To)
+  {
+    _Move Moves [MovesMax];
+    int n, i, Checkers;
+    //
+    if (Piece (Board [From.x][From.y]) == pEmpty)
+      return false;
+    n = GetLegalMoves (PieceWhite (Board [From.x][From.y]), Moves, &Checkers);
+    for (i = 0; i < n; i++)
+      if (Moves [i].From.x == From.x && Moves [i].From.y == From.y && Moves [i].To.x == To.x && Moves [i].To.y == To.y)
+        return true;
+    return false;
+  }
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// SEE: Static exchange evaluation. What a capture wins once all the recaptures on its square are done
+//
+// Each side recaptures with its least valuable piece, and either side may stop when going on would
+// lose. Pieces that have captured are taken off the board (Gone), which brings in the x-ray
+// attackers behind them, as aExtend sees them. Pins are ignored.
+
+// The least valuable of ByWhite's pieces attacking At, looking through the pieces in Gone
+
+bool SEEAttacker (_Coord At, bool ByWhite, _Squares Gone, _Coord *From)
+  {
+    _Coord *Dir, To;
+    _Piece p;
+    int x, y, Value;
+    bool Found;
+    //
+    // Pawns are least valuable, so take one at once
+    y = At.y + (ByWhite ? -1 : 1);
+    for (x = At.x - 1; x <= At.x + 1; x += 2)
+      if (OnBoard (x, y) && !(Gone & Square (x, y)) && PieceColour (Board [x][y]) == PieceFrom (pPawn, ByWhite))
+        {
+          From->x = x;
+          From->y = y;
+          return true;
+        }
+    Found = false;
+    Value = MAXINT;
+    // Knights: any one will do, and the sliders must be worth less to replace it
+    for (Dir = PieceMovesKnight; Dir->x != End; Dir++)
+      {
+        x = At.x + Dir->x;
+        y = At.y + Dir->y;
+        if (OnBoard (x, y) && !(Gone & Square (x, y)) && PieceColour (Board [x][y]) == PieceFrom (pKnight, ByWhite))
+          {
+            From->x = x;
+            From->y = y;
+            Value = PieceValue [pKnight];
+            Found = true;
+            break;
+          }
+      }
+    // Sliders and King: the first piece still there in each direction
+    for (Dir = PieceMovesAllDir; Dir->x != End; Dir++)
+      {
+        To.x = At.x + Dir->x;
+        To.y = At.y + Dir->y;
+        while (OnBoard (To.x, To.y) && (Piece (Board [To.x][To.y]) == pEmpty || (Gone & Square (To.x, To.y))))
+          {
+            To.x += Dir->x;
+            To.y += Dir->y;
+          }
+        if (!OnBoard (To.x, To.y))
+          continue;
+        p = Board [To.x][To.y];
+        if (PieceWhite (p) != ByWhite || PieceValue [Piece (p)] >= Value)
+          continue;
+        if (Piece (p) == pQueen || Piece (p) == ((Dir->x == 0 || Dir->y == 0) ? pRook : pBishop)
+            || (Piece (p) == pKing && Abs (To.x - At.x) <= 1 && Abs (To.y - At.y) <= 1))
+          {
+            *From = To;
+            Value = PieceValue [Piece (p)];
+            Found = true;
+          }
+      }
+    return Found;
+  }
+
+// True if From - To takes something, en passant included
+
+bool MoveCapture (_Coord From, _Coord To)
+  {
+    return Piece (Board [To.x][To.y]) != pEmpty || (Piece (Board [From.x][From.y]) == pPawn && From.x != To.x);
+  }
+
+// Material the player moving From - To wins (or loses if negative) in the exchange on To
+
+int SEE (_Coord From, _Coord To)
+  {
+    int Gain [33];
+    int d, Value;
+    _Piece p;
+    _Squares Gone;
+    bool White;
+    //
+    p = Board [From.x][From.y];
+    Gain [0] = PieceValue [Piece (Board [To.x][To.y])];
+    if (Piece (p) == pPawn && From.x != To.x && Piece (Board [To.x][To.y]) == pEmpty)   // en passant
+      Gain [0] = PieceValue [pPawn];
+    Value = PieceValue [Piece (p)];   // what's on To, to be taken next
+    if (Piece (p) == pPawn && To.y == LastRow [PieceWhite (p)])   // crowned
+      {
+        Gain [0] += PieceValue [pQueen] - PieceValue [pPawn];
+        Value = PieceValue [pQueen];
+      }
+    Gone = Square (From.x, From.y);
+    White = !PieceWhite (p);
+    d = 0;
+    while (d < 32)
+      {
+        d++;
+        Gain [d] = Value - Gain [d - 1];   // if taken, and the taker is taken
+        if (Max (-Gain [d - 1], Gain [d]) < 0)   // neither side can gain from going on
+          break;
+        if (!SEEAttacker (To, White, Gone, &From))
+          break;
+        Gone |= Square (From.x, From.y);
+        Value = PieceValue [Piece (Board [From.x][From.y])];
+        White = !White;
+      }
+    // Back up: each side takes or stops, whichever is better
+    while (--d > 0)
+      Gain [d - 1] = -Max (-Gain [d - 1], Gain [d]);
+    return Gain [0];
+  }
+
+// SEEHanging: Material the opponent wins by taking the piece on At. 0 if it's safe
+//
+// For the evaluation, to mark pieces left en prise
+
+int SEEHanging (_Coord At)
+  {
+    _Coord From;
+    //
+    if (Piece (Board [At.x][At.y]) == pEmpty || !SEEAttacker (At, !PieceWhite (Board [At.x][At.y]), 0, &From))
+      return 0;
+    return Max (SEE (From, At), 0);
+  }
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Recognise: An exact score for an ending in a tablebase (Tb <dir>), or in the bitbases: KPK, KRK
+// and KQK. Bare Kings, and a lone Bishop or Knight, are draws
+//
+// A tablebase gives the plies to mate, scored like a mate found by the search from this Depth. The
+// tables have no en passant, so aren't used when one is possible: the search plays it out. A
+// bitbase win scores the piece's value and a little for progress: the pawn's advance, or the lone
+// King driven to the edge with the Kings close. So the search heads for the mate, not just knows
+// it's there. Returns false for any other position.
+
+bool Recognise (bool PlayWhite, int Depth, int *Score)
+  {
+    _Coord At, Kings [2], Pce;
+    _Piece p, Extra;
+    _BitbaseTable Table;
+    char Kinds [TablebasePiecesMax];
+    int Squares [TablebasePiecesMax];
+    int n, Extras, KingsFound, Flip, Strong, Weak, Sq, v, dx;
+    bool StrongWhite, EnPassant;
+    //
+    if (!BitbaseReady && TablebasesN == 0)
+      return false;
+    n = 0;
+    Extras = 0;
+    KingsFound = 0;
+    Extra = pEmpty;
+    Pce.x = Pce.y = 0;
+    EnPassant = false;
+    for (At.y = 0; At.y < 8; At.y++)
+      for (At.x = 0; At.x < 8; At.x++)
+        {
+          p = Board [At.x][At.y];
+          if (Piece (p) == pEmpty)
+            continue;
+          if (n < TablebasePiecesMax)
+            {
+              Kinds [n] = TablebaseKinds [Piece (p) - pKing] + (PieceWhite (p) ? 0 : 'a' - 'A');
+              Squares [n] = At.y * 8 + At.x;
+            }
+          n++;
+          if (Piece (p) == pPawn && (p & pPawn2) && p / pMoveID == MoveID)   // just double moved
+            for (dx = -1; dx <= 1; dx += 2)
+              if (At.x + dx >= 0 && At.x + dx < 8 && PieceColour (Board [At.x + dx][At.y]) == PieceFrom (pPawn, !PieceWhite (p)))
+                EnPassant = true;
+          if (Piece (p) == pKing)
+            {
+              Kings [PieceWhite (p)] = At;
+              KingsFound |= 1 << PieceWhite (p);
+            }
+          else
+            {
+              if (++Extras > ((TablebasesN > 0) ? TablebasePiecesMax - 2 : 1))
+                return false;
+              Extra = p;
+              Pce = At;
             }
-        }   // no more pieces
-    if (BestScore == MININT)   // no moves available (without losing the king)
-      if (InCheck (PlayWhite))   // you are in checkmate
-        BestScore = MININT;
+        }
+    if (KingsFound != 3)   // a side with no King, as in a test position
+      return false;
+    if (TablebasesN > 0 && !EnPassant && (v = TablebaseProbe (n, Kinds, Squares, PlayWhite)) >= 0)
+      {
+        if (v == tvDraw)
+          *Score = 0;
+        else if (TablebaseMates (v))
+          *Score = MATE - (Depth + TablebasePlies (v));
+        else
+          *Score = -(MATE - (Depth + TablebasePlies (v)));
+        return true;
+      }
+    if (Extras > 1 || !BitbaseReady)
+      return false;
+    *Score = 0;
+    if (Extras == 0 || Piece (Extra) == pBishop || Piece (Extra) == pKnight)   // can't mate
+      return true;
+    Table = (Piece (Extra) == pQueen) ? bbKQK : (Piece (Extra) == pRook) ? bbKRK : bbKPK;
+    StrongWhite = PieceWhite (Extra);
+    Flip = StrongWhite ? 0 : 7;   // the bitbases have the strong side White
+    Strong = bbSquare (Kings [StrongWhite].x, Kings [StrongWhite].y ^ Flip);
+    Weak = bbSquare (Kings [!StrongWhite].x, Kings [!StrongWhite].y ^ Flip);
+    Sq = bbSquare (Pce.x, Pce.y ^ Flip);
+    if (!BitbaseWin (Table, PlayWhite == StrongWhite, Strong, Weak, Sq))
+      return true;
+    *Score = PieceValue [Piece (Extra)];
+    if (Table == bbKPK)
+      *Score += bbY (Sq) * PieceValue [pPawn] / 8;
+    else
+      *Score += (3 - Min (Min (bbX (Weak), 7 - bbX (Weak)), Min (bbY (Weak), 7 - bbY (Weak)))) * 100
+                - Max (Abs (bbX (Strong) - bbX (Weak)), Abs (bbY (Strong) - bbY (Weak))) * 20;
+    if (PlayWhite != StrongWhite)
+      *Score = -*Score;
+    return true;
+  }
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// BestMove: Calculate best move recursively
+//
+// Returns Score of best move
+//
+// Mate scores count the plies to the mate, so the quickest mate is preferred.
+//
+// Below the root the search is alpha-beta, with moves ordered by SEE so the cut offs come early:
+// winning captures, then even captures and quiet moves, then losing captures. After DepthPlay the
+// captures that don't lose material are played out (Quiesce) before the Board is scored. The
+// endings the bitbases and tablebases know are scored at once (Recognise).
+//
+// PV [Depth] holds the best line found from Depth on. Each root move is kept in RootMoves with its
+// line and score. The root raises Alpha to just under the best score so far, which picks the same
+// move but leaves the worse ones only bounded. With RootFullWindow set (BestMoves for more than one
+// move) every root move is searched with the full window so it gets an exact score.
+
+thread_local longint MovesConsidered;
+thread_local _Coord BestA [DepthMax], BestB [DepthMax];
+//_Coord BestA_ [DepthMax], BestB_ [DepthMax];   // copy best move sequence
+
+thread_local _Move PV [DepthMax][DepthMax];   // PV [Depth][Depth..PVLength [Depth]-1]
+thread_local int PVLength [DepthMax + 1];
+
+typedef struct
+  {
+    _Move Move;
+    int Score;
+    _Move Line [DepthMax];   // starting with Move
+    int LineLength;
+  } _RootMove;
+
+thread_local _RootMove RootMoves [MovesMax];
+thread_local int RootMovesN;
+thread_local bool RootFullWindow = false;
+
+// Stopping a search. SearchPoll, if set, is called every SearchPollMask + 1 moves and may set
+// SearchStop. Quiesce and BestMove then unwind at once, BestMove keeping BestA [0] / BestB [0] from
+// the root moves it finished. The root searches RootFirst first, if it's set.
+
+#define SearchPollMask 0x3FF
+
+thread_local void (*SearchPoll) (void) = NULL;
+thread_local bool SearchStop = false;
+thread_local _Move RootFirst = {{-1, -1}, {-1, -1}};
+
+#define SearchPollCheck() \
+  do { \
+    if ((MovesConsidered & SearchPollMask) == 0 && SearchPoll != NULL) \
+      SearchPoll (); \
+  } while (0)
+
+// Sort moves by SEE, best first, into Gain. Quiet moves go between the even and the losing captures
+
+void MovesOrder (_Move *Moves, int n, int *Gain)
+  {
+    _Move Move;
+    int g, i, j;
+    //
+    for (i = 0; i < n; i++)
+      {
+        Move = Moves [i];
+        if (MoveCapture (Move.From, Move.To))
+          g = SEE (Move.From, Move.To);
+        else
+          g = -1;   // just below an even capture
+        for (j = i; j > 0 && Gain [j - 1] < g; j--)
+          {
+            Moves [j] = Moves [j - 1];
+            Gain [j] = Gain [j - 1];
+          }
+        Moves [j] = Move;
+        Gain [j] = g;
+      }
+  }
+
+// Quiesce: Score the Board once the captures that don't lose material have been played out
+//
+// The player may stand pat on BoardScore rather than capture. Losing captures (by SEE) are pruned
+
+int Quiesce (bool PlayWhite, int Depth, int Alpha, int Beta)
+  {
+    _Move Moves [MovesMax], *m;
+    int Gain [MovesMax];
+    _Piece p, p_;
+    _SpecialMove sm;
+    int Score, BestScore;
+    int n, Checkers;
+    //
+    n = GetLegalMoves (PlayWhite, Moves, &Checkers);
+    if (n == 0)   // mated or stalemate
+      return (Checkers > 0) ? -(MATE - Depth) : 0;
+    if (Recognise (PlayWhite, Depth, &Score))
+      return Score;
+    BestScore = BoardScore (PlayWhite);   // stand pat
+    if (BestScore >= Beta)
+      return BestScore;
+    Alpha = Max (Alpha, BestScore);
+    MovesOrder (Moves, n, Gain);
+    for (m = Moves; m < Moves + n && Gain [m - Moves] >= 0; m++)   // captures not losing material
+      {
+        MovesConsidered++;
+        SearchPollCheck ();
+        p = Board [m->From.x][m->From.y];
+        p_ = Board [m->To.x][m->To.y];
+        sm = MovePiece (m->From, m->To);
+        Score = -Quiesce (!PlayWhite, Depth + 1, -Beta, -Alpha);
+        UnmovePiece (m->From, m->To, p, p_, sm);
+        if (SearchStop)   // BestMove throws it away
+          break;
+        if (Score > BestScore)
+          {
+            BestScore = Score;
+            if (Score >= Beta)
+              break;
+            Alpha = Max (Alpha, Score);
+          }
+      }
+    return BestScore;
+  }
+
+// With -DTRACE each move searched is recorded by Trace.c (included before this). Without, this costs
+// nothing
+
+#ifdef TRACE
+  #define TraceMove(Ply,Flags,Move,Alpha,Beta,Score,Nodes) \
+    do { \
+      if (TraceOn) \
+        TraceAdd (Ply, Flags, (Move).From.y * 8 + (Move).From.x, (Move).To.y * 8 + (Move).To.x, Alpha, Beta, Score, Nodes); \
+    } while (0)
+#else
+  #define TraceMove(Ply,Flags,Move,Alpha,Beta,Score,Nodes) do {} while (0)
+#endif
+
+int BestMove (bool PlayWhite, int Depth, int Alpha = MININT, int Beta = MAXINT)
+  {
+    _Move Moves [MovesMax], *m;
+    int Gain [MovesMax];
+    _Piece p, p_;
+    _SpecialMove sm;
+    int Score;
+    int BestScore;
+    int n, Checkers;
+    int i;
+    #ifdef TRACE
+      longint Nodes, Start = MovesConsidered;
+    #endif
+    //
+    BestScore = MININT;
+    PVLength [Depth] = Depth;
+    if (Depth == 0)
+      RootMovesN = 0;
+    n = GetLegalMoves (PlayWhite, Moves, &Checkers);
+    if (n == 0)   // no moves available
+      if (Checkers > 0)   // you are in checkmate. Later is better
+        return -(MATE - Depth);
       else   // Stale mate
-        BestScore = MAXINT;
+        return 0;
+    if (Depth > 0 && Recognise (PlayWhite, Depth, &Score))   // known ending. The root still needs a move
+      return Score;
+    MovesOrder (Moves, n, Gain);
+    if (Depth == 0 && RootFirst.From.x >= 0)
+      for (i = 1; i < n; i++)
+        if (Moves [i].From.x == RootFirst.From.x && Moves [i].From.y == RootFirst.From.y && Moves [i].To.x == RootFirst.To.x && Moves [i].To.y == RootFirst.To.y)
+          {
+            MemMove (&Moves [1], &Moves [0], i * sizeof (_Move));
+            Moves [0] = RootFirst;
+            break;
+          }
+    for (m = Moves; m < Moves + n; m++)   // for all moves
+      {
+        MovesConsidered++;
+        SearchPollCheck ();
+        #ifdef TRACE
+          Nodes = MovesConsidered;
+        #endif
+        p = Board [m->From.x][m->From.y];
+        p_ = Board [m->To.x][m->To.y];   // piece being taken (or Empty)
+        sm = MovePiece (m->From, m->To);
+        if (Depth == DepthPlay)   // Reached the limit of look-ahead
+          {
+            Score = -Quiesce (!PlayWhite, Depth + 1, -Beta, -Alpha);   // evaluate move, once the captures settle
+            PVLength [Depth + 1] = Depth + 1;
+          }
+        else   // otherwise find the reply move
+          Score = -BestMove (!PlayWhite, Depth + 1, -Beta, -Alpha);
+        if (SearchStop)   // Score is only part done
+          {
+            UnmovePiece (m->From, m->To, p, p_, sm);
+            break;
+          }
+        if (Score >= BestScore)
+          {
+            BestScore = Score;
+            BestA [Depth] = m->From;
+            BestB [Depth] = m->To;
+            PV [Depth][Depth] = *m;
+            for (i = Depth + 1; i < PVLength [Depth + 1]; i++)
+              PV [Depth][i] = PV [Depth + 1][i];
+            PVLength [Depth] = Max (PVLength [Depth + 1], Depth + 1);
+          }
+        if (Depth == 0)
+          {
+            RootMoves [RootMovesN].Move = *m;
+            RootMoves [RootMovesN].Score = Score;
+            RootMoves [RootMovesN].Line [0] = *m;
+            for (i = 1; i < PVLength [1]; i++)
+              RootMoves [RootMovesN].Line [i] = PV [1][i];
+            RootMoves [RootMovesN].LineLength = Max (PVLength [1], 1);
+            RootMovesN++;
+          }
+        UnmovePiece (m->From, m->To, p, p_, sm);
+        TraceMove (Depth, ((Depth > 0 && Score >= Beta) ? tfCutoff : 0) | ((Depth == DepthPlay) ? tfLeaf : 0),
+                   *m, Alpha, Beta, Score, MovesConsidered - Nodes + 1);
+        if (Depth > 0)
+          {
+            if (Score >= Beta)   // the opponent won't allow this line
+              break;
+            Alpha = Max (Alpha, Score);
+          }
+        else if (!RootFullWindow)   // one under, so an equal score is still exact and the last is kept
+          Alpha = Max (Alpha, Score - 1);
+      }
+    if (Depth == 0)
+      TraceMove (DepthPlay, tfSearch, PV [0][0], MININT, MAXINT, BestScore, MovesConsidered - Start);
     return BestScore;
   }
 
+// BestMoves: The best N moves, best first, with their scores and lines, from one search
+//
+// Res [0] is the move BestMove picks. Returns how many moves there are (up to N)
+
+int BestMoves (bool PlayWhite, int N, _RootMove *Res)
+  {
+    int i, j;
+    _RootMove Move;
+    //
+    RootFullWindow = N > 1;
+    BestMove (PlayWhite, 0);
+    RootFullWindow = false;
+    // Sort best first. Of equal scores BestMove keeps the last, so that goes first
+    for (i = 1; i < RootMovesN; i++)
+      {
+        Move = RootMoves [i];
+        for (j = i; j > 0 && RootMoves [j - 1].Score <= Move.Score; j--)
+          RootMoves [j] = RootMoves [j - 1];
+        RootMoves [j] = Move;
+      }
+    N = Min (N, RootMovesN);
+    for (i = 0; i < N; i++)
+      Res [i] = RootMoves [i];
+    return N;
+  }
+
+// BestMoveIterative: BestMove to depth 0, 1 ... Depth, or until SearchStop
+//
+// Each depth searches the last depth's best move first, so if it's stopped part way the best of
+// the root moves it did finish is at least as good: that's the move left in BestA [0] / BestB [0].
+// Depth 0 is always finished, without polling. SearchDepth is the depth being searched, and after,
+// the last depth searched (perhaps part way).
+
+thread_local int SearchDepth;
+
+int BestMoveIterative (bool PlayWhite, int Depth)
+  {
+    int DepthWas, Score, ScorePart, i;
+    void (*Poll) (void);
+    //
+    DepthWas = DepthPlay;
+    Poll = SearchPoll;
+    SearchStop = false;
+    RootFirst.From.x = -1;
+    Score = 0;
+    for (SearchDepth = 0; SearchDepth <= Depth; SearchDepth++)
+      {
+        DepthPlay = SearchDepth;
+        SearchPoll = (SearchDepth == 0) ? NULL : Poll;
+        ScorePart = BestMove (PlayWhite, 0);
+        if (SearchStop)
+          {
+            for (i = 0; i < RootMovesN; i++)   // the best of the moves finished
+              if (i == 0 || RootMoves [i].Score >= ScorePart)
+                ScorePart = RootMoves [i].Score;
+            if (RootMovesN > 0)
+              Score = ScorePart;
+            break;
+          }
+        Score = ScorePart;
+        if (RootMovesN <= 1 || ScoreMate (Score))   // nothing to choose, or mate found
+          break;
+        RootFirst.From = BestA [0];
+        RootFirst.To = BestB [0];
+      }
+    SearchDepth = Min (SearchDepth, Depth);
+    DepthPlay = DepthWas;
+    SearchPoll = Poll;
+    SearchStop = false;
+    RootFirst.From.x = -1;
+    return Score;
+  }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 //
@@ -549,29 +1319,14 @@ bool MoveValid (_Coord From, _Coord To)
 
 bool InCheck (bool PlayWhite)
   {
-    _Coord From, Moves [64], *m;
-    _Piece p, p_;
+    _Coord King, From;
+    _Piece p_;
     //
-    for (From.y = 0; From.y < 8; From.y++)   // for every square
-      for (From.x = 0; From.x < 8; From.x++)
-        {
-          p = (_Piece) Board [From.x][From.y];
-          if ((Piece (p) != pEmpty) && (PieceWhite (p) != PlayWhite))   // if not my piece
-            {
-              GetPieceMoves (From, Moves);
-              m = Moves;
-              while (m->x >= 0)   // for all moves
-                {
-                  p_ = Board [m->x][m->y];
-                  if (Piece (p_) == pKing)   // and it can take my king
-                    {
-                      Board [m->x][m->y] = (_Piece) (p_ | pChecked);
-                      return true;
-                    }
-                  m++;
-                }
-            }
-        }
+    if (FindKing (PlayWhite, &King) && SquareAttacked (King, !PlayWhite))
+      {
+        Board [King.x][King.y] = (_Piece) (Board [King.x][King.y] | pChecked);
+        return true;
+      }
     // Untag pChecked
     for (From.y = 0; From.y < 8; From.y++)   // for every square
       for (From.x = 0; From.x < 8; From.x++)
@@ -582,3 +1337,177 @@ bool InCheck (bool PlayWhite)
         }
     return false;
   }
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// BoardFromFEN: Set up the Board from a FEN string
+//
+// Castling rights are kept by leaving the King & Rook with Move ID 0. All other pieces are marked as
+// moved. An en passant square tags the pawn behind it as having just double moved.
+// Returns false if the FEN can't be read. Board is then undefined.
+
+_Piece FENPiece (char c)
+  {
+    _Piece p;
+    //
+    switch (c | 0x20)   // lower case
+      {
+        case 'k': p = pKing;   break;
+        case 'q': p = pQueen;  break;
+        case 'r': p = pRook;   break;
+        case 'b': p = pBishop; break;
+        case 'n': p = pKnight; break;
+        case 'p': p = pPawn;   break;
+        default:  return pEmpty;
+      }
+    return PieceFrom (p, c < 'a');
+  }
+
+bool BoardFromFEN (const char *FEN, bool *PlayWhite)
+  {
+    int x, y;
+    _Piece p;
+    //
+    MoveID = 1;
+    for (y = 0; y < 8; y++)
+      for (x = 0; x < 8; x++)
+        Board [x][y] = pEmpty;
+    // Piece placement, from rank 8 down
+    x = 0;
+    y = 7;
+    while (*FEN && *FEN != ' ')
+      {
+        if (*FEN == '/')
+          {
+            if (x != 8 || y == 0)
+              return false;
+            x = 0;
+            y--;
+          }
+        else if (*FEN >= '1' && *FEN <= '8')
+          x += *FEN - '0';
+        else
+          {
+            p = FENPiece (*FEN);
+            if (p == pEmpty || x > 7)
+              return false;
+            Board [x][y] = (_Piece) (p | pMoveID);   // moved at Move ID 1
+            x++;
+          }
+        if (x > 8)
+          return false;
+        FEN++;
+      }
+    if (x != 8 || y != 0)
+      return false;
+    // Side to move
+    while (*FEN == ' ')
+      FEN++;
+    if (*FEN != 'w' && *FEN != 'b')
+      return false;
+    *PlayWhite = (*FEN++ == 'w');
+    // Castling rights: King and Rook have never moved
+    while (*FEN == ' ')
+      FEN++;
+    while (*FEN && *FEN != ' ')
+      {
+        p = FENPiece (*FEN);
+        y = FirstY [PieceWhite (p)];
+        if (Piece (p) == pKing || Piece (p) == pQueen)
+          {
+            x = (Piece (p) == pKing) ? 7 : 0;
+            if (Piece (Board [4][y]) == pKing && Piece (Board [x][y]) == pRook)
+              {
+                Board [4][y] = (_Piece) (Board [4][y] & (pMoveID - 1));
+                Board [x][y] = (_Piece) (Board [x][y] & (pMoveID - 1));
+              }
+          }
+        FEN++;
+      }
+    // En passant: the pawn that just double moved
+    while (*FEN == ' ')
+      FEN++;
+    if (*FEN >= 'a' && *FEN <= 'h' && (FEN [1] == '3' || FEN [1] == '6'))
+      {
+        x = *FEN - 'a';
+        y = (FEN [1] == '3') ? 3 : 4;
+        if (Piece (Board [x][y]) == pPawn)
+          Board [x][y] = (_Piece) (Board [x][y] | pPawn2);
+      }
+    return true;
+  }
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Bench: Fixed set of positions searched to a fixed depth with no randomness
+//
+// The total of MovesConsidered over the set is a signature of the engine's behaviour.
+// A change that is only meant to be faster must not change it.
+
+const char *BenchPositions [] =
+  {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 10",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 11",
+    "4rrk1/pp1n3p/3q2pQ/2p1pb2/2PP4/2P3N1/P2B2PP/4RRK1 b - - 7 19",
+    "rq3rk1/ppp2ppp/1bnpb3/3N2B1/3NP3/7P/PPPQ1PP1/2KR3R w - - 7 14",
+    "r1bq1r1k/1pp1n1pp/1p1p4/4p2Q/4Pp2/1BNP4/PPP2PPP/3R1RK1 w - - 2 14",
+    "r3r1k1/2p2ppp/p1p1bn2/8/1q2P3/2NPQN2/PPP3PP/R4RK1 b - - 2 15",
+    "r1bbk1nr/pp3p1p/2n5/1N4p1/2Np1B2/8/PPP2PPP/2KR1B1R w kq - 0 13",
+    "r1bq1rk1/ppp1nppp/4n3/3p3Q/3P4/1BP1B3/PP1N2PP/R4RK1 w - - 1 16",
+    "4r1k1/r1q2ppp/ppp2n2/4P3/5Rb1/1N1BQ3/PPP3PP/R5K1 w - - 1 17",
+    "2rqkb1r/ppp2p2/2npb1p1/1N1Nn2p/2P1PP2/8/PP2B1PP/R1BQK2R b KQ - 0 11",
+    "r1bq1r1k/b1p1npp1/p2p3p/1p6/3PP3/1B2NN2/PP3PPP/R2Q1RK1 w - - 1 16",
+    "3r1rk1/p5pp/bpp1pp2/8/q1PP1P2/b3P3/P2NQRPP/1R2B1K1 b - - 6 22",
+    "r1q2rk1/2p1bppp/2Pp4/p6b/Q1PNp3/4B3/PP1R1PPP/2K4R w - - 2 18",
+    "4k2r/1pb2ppp/1p2p3/1R1p4/3P4/2r1PN2/P4PPP/1R4K1 b - - 3 22",
+    "3q2k1/pb3p1p/4pbp1/2r5/PpN2N2/1P2P2P/5PP1/Q2R2K1 b - - 4 26",
+    "r2r1n2/pp2bk2/2p1p2p/3q4/3PN1QP/2P3R1/P4PP1/5RK1 w - - 0 1",
+    "6k1/3b3r/1p1p4/p1n2p2/1PPNpP1q/P3Q1p1/1R1RB1P1/5K2 b - - 0 1",
+    "1r3k2/4q3/2Pp3b/3Bp3/2Q2p2/1p1P2P1/1P2KP2/3N4 w - - 0 1",
+    "6k1/4pp1p/3p2p1/P1pPb3/R7/1r2P1PP/3B1P2/6K1 w - - 0 1",
+    "6k1/6p1/P6p/r1N5/5p2/7P/1b3PP1/4R1K1 w - - 0 1",
+    "8/pp2r1k1/2p1p3/3pP2p/1P1P1P1P/P5KR/8/8 w - - 0 1",
+    "8/3p4/p1bk3p/Pp6/1Kp1PpPp/2P2P1P/2P5/5B2 b - - 0 1",
+    "6k1/6p1/6Pp/ppp5/3pn2P/1P3K2/1PP2P2/3N4 b - - 0 1",
+    "3b4/5kp1/1p1p1p1p/pP1PpP1P/P1P1P3/3KN3/8/8 w - - 0 1",
+    "8/6pk/1p6/8/PP3p1p/5P2/4KP1q/3Q4 w - - 0 1",
+    "7k/3p2pp/4q3/8/4Q3/5Kp1/P6b/8 w - - 0 1",
+    "5k2/7R/4P2p/5K2/p1r2P1p/8/8/8 b - - 0 1",
+    "2K5/p7/7P/5pR1/8/5k2/r7/8 w - - 0 1",
+    "8/R7/2q5/8/6k1/8/1P5p/K6R w - - 0 124",
+    "8/3p3B/5p2/5P2/p7/PP5b/k7/6K1 w - - 0 1",
+    "8/2p5/8/2kPKp1p/2p4P/2P5/3P4/8 w - - 0 1",
+    "8/1p3pp1/7p/5P1P/2k3P1/8/2K2P2/8 w - - 0 1",
+    "8/8/1P6/5pr1/8/4R3/7k/2K5 w - - 0 1",
+    "8/2p4P/8/kr6/6R1/8/8/1K6 w - - 0 1",
+    "8/8/3P3k/8/1p6/8/1P6/1K3n2 b - - 0 1",
+    "8/8/8/8/5kp1/P7/8/1K1N4 w - - 0 1",
+    "8/8/8/5N2/8/p7/8/2NK3k w - - 0 1",
+    "8/3k4/8/8/8/4B3/4KB2/2B5 w - - 0 1",
+    "8/8/8/8/8/6k1/6p1/6K1 w - - 0 1",
+    "8/8/8/8/8/6k1/8/6K1 w - - 0 1",   // bare Kings
+    NULL
+  };
+
+// Search one bench position. Returns the moves considered, or -1 if the FEN is bad
+
+longint BenchPosition (const char *FEN, int Depth)
+  {
+    bool PlayWhite;
+    int DepthPlay_, Randomize_;
+    //
+    if (!BoardFromFEN (FEN, &PlayWhite))
+      return -1;
+    DepthPlay_ = DepthPlay;
+    Randomize_ = Randomize;
+    DepthPlay = Depth;
+    Randomize = 0;
+    MovesConsidered = 0;
+    InCheck (PlayWhite);   // update Checked status on King piece
+    BestMove (PlayWhite, 0);
+    DepthPlay = DepthPlay_;
+    Randomize = Randomize_;
+    return MovesConsidered;
+  }
@@ -0,0 +1,101 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// FILE MAPPING
+//
+// Author: Stewart Tunbridge, Pi Micros
+// Email:  stewarttunbridge@gmail.com
+// Copyright (c) 2025 Stewart Tunbridge, Pi Micros
+//
+// Map a whole file read only into memory, for Linux and Windows
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifdef _Windows
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+typedef struct
+  {
+    const char *Data;
+    longint Size;
+    #ifdef _Windows
+      HANDLE File, Mapping;
+    #endif
+  } _FileMap;
+
+bool FileMapOpen (const char *FileName, _FileMap *Map)
+  {
+    Map->Data = NULL;
+    Map->Size = 0;
+    #ifdef _Windows
+      LARGE_INTEGER Size;
+      //
+      Map->File = CreateFileA (FileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+      if (Map->File == INVALID_HANDLE_VALUE)
+        return false;
+      GetFileSizeEx (Map->File, &Size);
+      Map->Size = Size.QuadPart;
+      Map->Mapping = NULL;
+      if (Map->Size > 0)
+        {
+          Map->Mapping = CreateFileMappingA (Map->File, NULL, PAGE_READONLY, 0, 0, NULL);
+          if (Map->Mapping != NULL)
+            Map->Data = (const char *) MapViewOfFile (Map->Mapping, FILE_MAP_READ, 0, 0, 0);
+          if (Map->Data == NULL)
+            {
+              if (Map->Mapping != NULL)
+                CloseHandle (Map->Mapping);
+              CloseHandle (Map->File);
+              return false;
+            }
+        }
+    #else
+      int f;
+      struct stat Stat;
+      void *Data;
+      //
+      f = open (FileName, O_RDONLY);
+      if (f < 0)
+        return false;
+      if (fstat (f, &Stat) < 0)
+        {
+          close (f);
+          return false;
+        }
+      Map->Size = Stat.st_size;
+      if (Map->Size > 0)
+        {
+          Data = mmap (NULL, Map->Size, PROT_READ, MAP_PRIVATE, f, 0);
+          if (Data == MAP_FAILED)
+            {
+              close (f);
+              return false;
+            }
+          madvise (Data, Map->Size, MADV_SEQUENTIAL);
+          Map->Data = (const char *) Data;
+        }
+      close (f);   // the mapping stays valid
+    #endif
+    return true;
+  }
+
+void FileMapClose (_FileMap *Map)
+  {
+    #ifdef _Windows
+      if (Map->Data != NULL)
+        UnmapViewOfFile (Map->Data);
+      if (Map->Mapping != NULL)
+        CloseHandle (Map->Mapping);
+      CloseHandle (Map->File);
+    #else
+      if (Map->Data != NULL)
+        munmap ((void *) Map->Data, Map->Size);
+    #endif
+    Map->Data = NULL;
+    Map->Size = 0;
+  }
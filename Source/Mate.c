@@ -0,0 +1,291 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// MATE SOLVER
+//
+// Author: Stewart Tunbridge, Pi Micros
+// Email:  stewarttunbridge@gmail.com
+// Copyright (c) 2025 Stewart Tunbridge, Pi Micros
+//
+// Proof number search for a forced mate.
+//
+// The tree is grown one node at a time, always from the most proving node: the one whose solving
+// would do most to prove or disprove the root. Proof (Disproof) is how many more leaves must be
+// proven (disproven) to prove (disprove) a node. The attacker needs just one move that mates, the
+// defender needs all his moves to lose.
+//
+// Nodes come from a fixed pool so memory is bounded. If it runs out the answer is unknown.
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#define PNInfinite 100000000
+
+typedef struct
+  {
+    int Proof, Disproof;
+    int Child;   // first child, the rest follow it. -1 => not expanded
+    int Parent;
+    unsigned short Children;
+    _Move Move;   // move into this node
+  } _PNNode;
+
+_PNNode *PNNodes = NULL;
+int PNNodesMax;
+int PNNodesN;
+
+// Sums saturate at PNInfinite
+
+int PNAdd (int a, int b)
+  {
+    if (a >= PNInfinite - b)
+      return PNInfinite;
+    return a + b;
+  }
+
+// Set Proof & Disproof for the position on the Board. Ply plies in, attacker to move on even plies.
+// The attacker has had his MaxMoves moves once it's ply 2 * MaxMoves - 1, so a defender who isn't
+// mated then has escaped
+
+void PNEvaluate (_PNNode *Node, bool PlayWhite, int Ply, int MaxMoves)
+  {
+    _Move Moves [MovesMax];
+    int n, Checkers;
+    bool Attacker;
+    //
+    Attacker = (Ply & 1) == 0;
+    n = GetLegalMoves (PlayWhite, Moves, &Checkers);
+    if (n == 0 && Checkers > 0 && !Attacker)   // defender mated
+      {
+        Node->Proof = 0;
+        Node->Disproof = PNInfinite;
+      }
+    else if (n == 0 || Ply >= 2 * MaxMoves - 1)   // attacker mated, stalemate or out of moves
+      {
+        Node->Proof = PNInfinite;
+        Node->Disproof = 0;
+      }
+    else if (Attacker)   // one move will do
+      {
+        Node->Proof = 1;
+        Node->Disproof = n;
+      }
+    else   // every move must lose
+      {
+        Node->Proof = n;
+        Node->Disproof = 1;
+      }
+  }
+
+// Add all the children of Node. Board is the position at Node. Returns false if out of nodes
+
+bool PNExpand (int Node, bool PlayWhite, int Ply, int MaxMoves)
+  {
+    _Move Moves [MovesMax];
+    _PNNode *Child;
+    _Piece p, p_;
+    _SpecialMove sm;
+    int n, i, Checkers;
+    //
+    n = GetLegalMoves (PlayWhite, Moves, &Checkers);
+    if (PNNodesN + n > PNNodesMax)
+      return false;
+    PNNodes [Node].Child = PNNodesN;
+    PNNodes [Node].Children = n;
+    for (i = 0; i < n; i++)
+      {
+        Child = &PNNodes [PNNodesN++];
+        Child->Child = -1;
+        Child->Children = 0;
+        Child->Parent = Node;
+        Child->Move = Moves [i];
+        p = Board [Moves [i].From.x][Moves [i].From.y];
+        p_ = Board [Moves [i].To.x][Moves [i].To.y];
+        sm = MovePiece (Moves [i].From, Moves [i].To);
+        PNEvaluate (Child, !PlayWhite, Ply + 1, MaxMoves);
+        UnmovePiece (Moves [i].From, Moves [i].To, p, p_, sm);
+      }
+    return true;
+  }
+
+// Proof & Disproof of an expanded node from its children
+
+void PNUpdate (_PNNode *Node, bool Attacker)
+  {
+    _PNNode *c;
+    int i;
+    //
+    if (Attacker)
+      {
+        Node->Proof = PNInfinite;
+        Node->Disproof = 0;
+      }
+    else
+      {
+        Node->Proof = 0;
+        Node->Disproof = PNInfinite;
+      }
+    for (i = 0; i < Node->Children; i++)
+      {
+        c = &PNNodes [Node->Child + i];
+        if (Attacker)
+          {
+            Node->Proof = Min (Node->Proof, c->Proof);
+            Node->Disproof = PNAdd (Node->Disproof, c->Disproof);
+          }
+        else
+          {
+            Node->Proof = PNAdd (Node->Proof, c->Proof);
+            Node->Disproof = Min (Node->Disproof, c->Disproof);
+          }
+      }
+  }
+
+typedef struct
+  {
+    _Move Move;
+    _Piece From, To;
+    _SpecialMove sm;
+  } _PNPath;
+
+// Prove or disprove mate in up to MaxMoves from the Board. Returns 1 proven, 0 disproven,
+// -1 out of nodes
+
+int PNSearch (bool PlayWhite, int MaxMoves)
+  {
+    _PNPath Path [2 * 64];
+    _PNNode *Node, *c;
+    int Ply, i, Best, Result;
+    bool Attacker;
+    //
+    PNNodesN = 1;
+    PNNodes [0].Child = -1;
+    PNNodes [0].Children = 0;
+    PNNodes [0].Parent = -1;
+    PNEvaluate (&PNNodes [0], PlayWhite, 0, MaxMoves);
+    Result = 1;
+    while (PNNodes [0].Proof != 0 && PNNodes [0].Disproof != 0)
+      {
+        // Down to the most proving node
+        Node = &PNNodes [0];
+        Ply = 0;
+        while (Node->Child >= 0)
+          {
+            Attacker = (Ply & 1) == 0;
+            Best = Node->Child;
+            for (i = 1; i < Node->Children; i++)
+              {
+                c = &PNNodes [Node->Child + i];
+                if (Attacker ? (c->Proof < PNNodes [Best].Proof) : (c->Disproof < PNNodes [Best].Disproof))
+                  Best = Node->Child + i;
+              }
+            Node = &PNNodes [Best];
+            Path [Ply].Move = Node->Move;
+            Path [Ply].From = Board [Node->Move.From.x][Node->Move.From.y];
+            Path [Ply].To = Board [Node->Move.To.x][Node->Move.To.y];
+            Path [Ply].sm = MovePiece (Node->Move.From, Node->Move.To);
+            Ply++;
+          }
+        if (!PNExpand (Node - PNNodes, (Ply & 1) ? !PlayWhite : PlayWhite, Ply, MaxMoves))
+          Result = -1;
+        // Back up to the root
+        while (true)
+          {
+            if (Result >= 0)
+              PNUpdate (Node, (Ply & 1) == 0);
+            if (Ply == 0)
+              break;
+            Ply--;
+            UnmovePiece (Path [Ply].Move.From, Path [Ply].Move.To, Path [Ply].From, Path [Ply].To, Path [Ply].sm);
+            Node = &PNNodes [Node->Parent];
+          }
+        if (Result < 0)
+          return -1;
+      }
+    return PNNodes [0].Proof == 0;
+  }
+
+// Plies to mate in Node's proven tree: the attacker takes his quickest proven move, the defender
+// his longest
+
+int PNMateDepth (int Node, bool Attacker)
+  {
+    _PNNode *c;
+    int i, Depth, Best;
+    //
+    if (PNNodes [Node].Child < 0)
+      return 0;
+    Best = Attacker ? PNInfinite : 0;
+    for (i = 0; i < PNNodes [Node].Children; i++)
+      {
+        c = &PNNodes [PNNodes [Node].Child + i];
+        if (c->Proof != 0)
+          continue;
+        Depth = 1 + PNMateDepth (PNNodes [Node].Child + i, !Attacker);
+        Best = Attacker ? Min (Best, Depth) : Max (Best, Depth);
+      }
+    return Best;
+  }
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// MateSolve: Find the quickest forced mate for PlayWhite, in up to MaxMoves moves
+//
+// MaxNodes bounds the memory used (MaxNodes * sizeof (_PNNode)). Nodes counts the nodes made.
+// Returns the moves to mate, with the mating line in Line (LineLength plies). 0 => no mate in
+// MaxMoves. -1 => not solved in MaxNodes
+//
+// The line is the longest defence against the quickest mate the tree proves, so it's as long as
+// the mate reported
+
+int MateSolve (bool PlayWhite, int MaxMoves, int MaxNodes, _Move *Line, int *LineLength, longint *Nodes)
+  {
+    int Moves, Result, Node, i, Depth, Best, BestDepth;
+    bool Attacker;
+    //
+    *LineLength = 0;
+    *Nodes = 0;
+    MaxMoves = Min (MaxMoves, 64);
+    PNNodes = (_PNNode *) malloc ((longint) MaxNodes * sizeof (_PNNode));
+    if (PNNodes == NULL)
+      return -1;
+    PNNodesMax = MaxNodes;
+    // Mate in 1, then 2 ... so the first found is the quickest
+    Result = 0;
+    for (Moves = 1; Moves <= MaxMoves; Moves++)
+      {
+        Result = PNSearch (PlayWhite, Moves);
+        *Nodes += PNNodesN;
+        if (Result != 0)
+          break;
+      }
+    if (Result == 1)
+      {
+        // Follow proven nodes for the line
+        Node = 0;
+        Attacker = true;
+        while (PNNodes [Node].Child >= 0)
+          {
+            Best = -1;
+            BestDepth = 0;
+            for (i = 0; i < PNNodes [Node].Children; i++)
+              if (PNNodes [PNNodes [Node].Child + i].Proof == 0)
+                {
+                  Depth = PNMateDepth (PNNodes [Node].Child + i, !Attacker);
+                  if (Best < 0 || (Attacker ? Depth < BestDepth : Depth > BestDepth))
+                    {
+                      Best = PNNodes [Node].Child + i;
+                      BestDepth = Depth;
+                    }
+                }
+            if (Best < 0)
+              break;
+            Node = Best;
+            Line [(*LineLength)++] = PNNodes [Node].Move;
+            Attacker = !Attacker;
+          }
+        Result = Moves;
+      }
+    free (PNNodes);
+    PNNodes = NULL;
+    return Result;
+  }
@@ -0,0 +1,269 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PACKED POSITIONS
+//
+// Author: Stewart Tunbridge, Pi Micros
+// Email:  stewarttunbridge@gmail.com
+// Copyright (c) 2025 Stewart Tunbridge, Pi Micros
+//
+// A position in 32 bytes, for sets of millions of them: tuning data, analysis, caches.
+//
+// The pieces are an occupancy bitmap and then 4 bits (PieceColour) for each piece, in square order.
+// What the Board keeps in the pieces' flags is kept apart: castling rights (King and Rook never
+// moved) and the Pawn that may be taken en passant. Then the clocks, and room for a result and a
+// score so a set can be labelled.
+//
+// A file is a _PackedHeader then the records, so it can be memory mapped and used as it is. Reading
+// one back is a matter of splitting it between threads (PackedForEach), each unpacking onto its own
+// Board.
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <string.h>
+
+#define PackedMagic 0x314B5043   // "CPK1"
+
+// Flags
+#define pfWhiteToMove 0x01
+#define pfCastleK     0x02   // White, King's side
+#define pfCastleQ     0x04
+#define pfCastlek     0x08   // Black
+#define pfCastleq     0x10
+
+typedef struct
+  {
+    _Squares Occupied;   // bit y * 8 + x
+    unsigned char Pieces [16];   // PieceColour of each piece in Occupied, low 4 bits first
+    unsigned char Flags;
+    unsigned char EnPassant;   // file + 1 of the Pawn that just moved 2, 0 => none
+    unsigned char HalfMoves;   // since the last capture or Pawn move
+    signed char Result;   // half points for White: 0, 1, 2. PgnUnknown => none
+    unsigned short FullMoves;
+    short Score;   // White's point of view
+  } _Packed;
+
+typedef char _PackedSize [sizeof (_Packed) == 32 ? 1 : -1];
+
+typedef struct
+  {
+    unsigned int Magic;
+    unsigned int RecordSize;
+    longint Count;
+  } _PackedHeader;
+
+// Castling: King's square, Rook's square and flag, for each
+int PackedCastleRook [4][2] = {{7, 0}, {0, 0}, {7, 7}, {0, 7}};
+int PackedCastleFlag [4] = {pfCastleK, pfCastleQ, pfCastlek, pfCastleq};
+
+// PackBoard: Pack the Board. Returns false if it has over 32 pieces
+
+bool PackBoard (bool PlayWhite, _Packed *p)
+  {
+    int x, y, n, c;
+    _Piece Pce, King, Rook;
+    //
+    memset (p, 0, sizeof (_Packed));
+    n = 0;
+    for (y = 0; y < 8; y++)
+      for (x = 0; x < 8; x++)
+        {
+          Pce = Board [x][y];
+          if (Piece (Pce) == pEmpty)
+            continue;
+          if (n == 32)
+            return false;
+          p->Occupied |= Square (x, y);
+          p->Pieces [n >> 1] |= PieceColour (Pce) << ((n & 1) * 4);
+          n++;
+          if (Piece (Pce) == pPawn && (Pce & pPawn2) && Pce / pMoveID == MoveID)
+            p->EnPassant = x + 1;
+        }
+    p->Flags = PlayWhite ? pfWhiteToMove : 0;
+    for (c = 0; c < 4; c++)
+      {
+        y = PackedCastleRook [c][1];
+        King = Board [4][y];
+        Rook = Board [PackedCastleRook [c][0]][y];
+        if (PieceColour (King) == PieceFrom (pKing, y == 0) && King / pMoveID == 0 && PieceColour (Rook) == PieceFrom (pRook, y == 0) && Rook / pMoveID == 0)
+          p->Flags |= PackedCastleFlag [c];
+      }
+    p->Result = PgnUnknown;
+    p->FullMoves = 1;
+    return true;
+  }
+
+// UnpackBoard: Set up the Board from p, as BoardFromFEN would, and who's to play. Returns false,
+// leaving the Board, if p can't be a packed position: over 32 pieces, a piece code that isn't one,
+// castling without its King and Rook at home or a file past h
+
+bool UnpackBoard (const _Packed *p, bool *PlayWhite)
+  {
+    int i, n, c, x, y;
+    _Squares Occupied;
+    _Piece Squares [64];
+    //
+    if (p->EnPassant > 8 || __builtin_popcountll (p->Occupied) > 32)
+      return false;
+    for (i = 0; i < 64; i++)
+      Squares [i] = pEmpty;
+    Occupied = p->Occupied;
+    for (n = 0; Occupied; n++)
+      {
+        i = __builtin_ctzll (Occupied);
+        Occupied &= Occupied - 1;
+        Squares [i] = (_Piece) ((p->Pieces [n >> 1] >> ((n & 1) * 4)) & 0x0F);
+        if (Piece (Squares [i]) == pEmpty || Piece (Squares [i]) > pPawn)
+          return false;
+        Squares [i] = (_Piece) (Squares [i] | pMoveID);   // moved at Move ID 1
+      }
+    for (c = 0; c < 4; c++)
+      if (p->Flags & PackedCastleFlag [c])
+        {
+          x = PackedCastleRook [c][0];
+          y = PackedCastleRook [c][1];
+          if (PieceColour (Squares [y * 8 + 4]) != PieceFrom (pKing, y == 0) || PieceColour (Squares [y * 8 + x]) != PieceFrom (pRook, y == 0))
+            return false;
+          Squares [y * 8 + 4] = (_Piece) (Squares [y * 8 + 4] & (pMoveID - 1));
+          Squares [y * 8 + x] = (_Piece) (Squares [y * 8 + x] & (pMoveID - 1));
+        }
+    MoveID = 1;
+    for (i = 0; i < 64; i++)
+      Board [i & 7][i >> 3] = Squares [i];
+    if (p->EnPassant)
+      {
+        y = (p->Flags & pfWhiteToMove) ? 4 : 3;   // the other side's Pawn
+        Board [p->EnPassant - 1][y] = (_Piece) (Board [p->EnPassant - 1][y] | pPawn2);
+      }
+    *PlayWhite = (p->Flags & pfWhiteToMove) != 0;
+    return true;
+  }
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Packed files
+//
+
+typedef struct
+  {
+    FILE *File;
+    longint Count;
+  } _PackedWriter;
+
+bool PackedCreate (const char *FileName, _PackedWriter *w)
+  {
+    _PackedHeader Header;
+    //
+    w->File = fopen (FileName, "wb");
+    w->Count = 0;
+    if (w->File == NULL)
+      return false;
+    Header.Magic = PackedMagic;
+    Header.RecordSize = sizeof (_Packed);
+    Header.Count = 0;
+    return fwrite (&Header, sizeof (Header), 1, w->File) == 1;
+  }
+
+bool PackedWrite (_PackedWriter *w, const _Packed *p, longint n)
+  {
+    w->Count += n;
+    return (longint) fwrite (p, sizeof (_Packed), n, w->File) == n;
+  }
+
+// Close, putting the count in the header. Returns false if anything failed
+
+bool PackedClose (_PackedWriter *w)
+  {
+    _PackedHeader Header;
+    bool OK;
+    //
+    Header.Magic = PackedMagic;
+    Header.RecordSize = sizeof (_Packed);
+    Header.Count = w->Count;
+    OK = !ferror (w->File) && fseek (w->File, 0, SEEK_SET) == 0 && fwrite (&Header, sizeof (Header), 1, w->File) == 1;
+    return (fclose (w->File) == 0) && OK;
+  }
+
+typedef struct
+  {
+    _FileMap Map;
+    const _Packed *Records;
+    longint Count;
+  } _PackedFile;
+
+// Map a packed file. Returns false if it can't, or it isn't one
+
+bool PackedOpen (const char *FileName, _PackedFile *f)
+  {
+    const _PackedHeader *Header;
+    //
+    if (!FileMapOpen (FileName, &f->Map))
+      return false;
+    Header = (const _PackedHeader *) f->Map.Data;
+    if (f->Map.Size < (longint) sizeof (_PackedHeader) || Header->Magic != PackedMagic || Header->RecordSize != sizeof (_Packed))
+      {
+        FileMapClose (&f->Map);
+        return false;
+      }
+    f->Records = (const _Packed *) (f->Map.Data + sizeof (_PackedHeader));
+    f->Count = Min (Header->Count, (f->Map.Size - (longint) sizeof (_PackedHeader)) / (longint) sizeof (_Packed));
+    return true;
+  }
+
+void PackedCloseFile (_PackedFile *f)
+  {
+    FileMapClose (&f->Map);
+  }
+
+// PackedForEach: Unpack Records [0..n-1] in Threads slices, calling Func with each on the Board.
+// Users [i] (UserSize bytes each) is given to slice i. Records that won't unpack are skipped.
+// Returns how many were
+
+typedef void (*_PackedFunc) (void *User, const _Packed *p, longint Index, bool PlayWhite);
+
+typedef struct
+  {
+    const _Packed *Records;
+    longint From, To;
+    _PackedFunc Func;
+    void *User;
+    longint Skipped;
+  } _PackedSlice;
+
+void PackedSlice (void *Param)
+  {
+    _PackedSlice *Slice;
+    longint i;
+    bool PlayWhite;
+    //
+    Slice = (_PackedSlice *) Param;
+    for (i = Slice->From; i < Slice->To; i++)
+      if (UnpackBoard (&Slice->Records [i], &PlayWhite))
+        Slice->Func (Slice->User, &Slice->Records [i], i, PlayWhite);
+      else
+        Slice->Skipped++;
+  }
+
+longint PackedForEach (const _Packed *Records, longint n, _PackedFunc Func, void *Users, int UserSize, int Threads)
+  {
+    _PackedSlice Slices [256];
+    longint Skipped;
+    int i;
+    //
+    Threads = Min (Max (Threads, 1), 256);
+    for (i = 0; i < Threads; i++)
+      {
+        Slices [i].Records = Records;
+        Slices [i].From = n * i / Threads;
+        Slices [i].To = n * (i + 1) / Threads;
+        Slices [i].Func = Func;
+        Slices [i].User = (char *) Users + i * UserSize;
+        Slices [i].Skipped = 0;
+      }
+    ThreadsParallel (PackedSlice, Slices, sizeof (_PackedSlice), Threads);
+    Skipped = 0;
+    for (i = 0; i < Threads; i++)
+      Skipped += Slices [i].Skipped;
+    return Skipped;
+  }
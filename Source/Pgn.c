@@ -0,0 +1,411 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PGN READER
+//
+// Author: Stewart Tunbridge, Pi Micros
+// Email:  stewarttunbridge@gmail.com
+// Copyright (c) 2025 Stewart Tunbridge, Pi Micros
+//
+// Replay the games in a PGN file through MovePiece.
+//
+// The file is memory mapped and split between threads on game boundaries. Each thread replays its
+// games on its own (thread_local) Board and reports every position to a _PgnSink. Tokens are read
+// in place, nothing is allocated per game or per move.
+//
+// Each SAN move is resolved by finding the one legal move that matches it. Only the pieces of the
+// kind named, on the From file or rank if given, have their moves made (GetPieceMoves), and only
+// those that reach To are tried on the board for check.
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Results, in half points for White. As used by Tune.c
+
+#define PgnUnknown -1
+
+// Where the games go. Position is called with the Board set up before each move
+
+typedef struct
+  {
+    void (*Position) (void *User, bool PlayWhite, _Coord From, _Coord To, int Result);
+    void (*GameEnd) (void *User, int Result, int Moves, bool Error);
+  } _PgnSink;
+
+typedef struct
+  {
+    const char *Start, *Stop;   // this thread's share of the file
+    const _PgnSink *Sink;
+    void *User;
+    longint Games, Moves, Errors;
+  } _PgnSlice;
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PgnMove: Resolve one SAN move to From, To and the piece a pawn is crowned to
+//
+// Returns false if it isn't a legal move
+
+_Piece PgnPieceLetter (char c)
+  {
+    switch (c)
+      {
+        case 'K': return pKing;
+        case 'Q': return pQueen;
+        case 'R': return pRook;
+        case 'B': return pBishop;
+        case 'N': return pKnight;
+      }
+    return pEmpty;
+  }
+
+// True if the pseudo legal move From - To doesn't leave the player's King (on King) in check, or
+// castle out of or through it
+
+bool PgnLegal (bool PlayWhite, _Coord King, _Coord From, _Coord To)
+  {
+    _Piece OldFrom, OldTo;
+    _SpecialMove sm;
+    _Coord Over;
+    bool OK;
+    //
+    OldFrom = Board [From.x][From.y];
+    if (Piece (OldFrom) == pKing && Abs (To.x - From.x) == 2)   // Castle
+      {
+        Over.x = (From.x + To.x) / 2;
+        Over.y = From.y;
+        return !SquareAttacked (From, !PlayWhite) && !SquareAttacked (Over, !PlayWhite) && !SquareAttacked (To, !PlayWhite);
+      }
+    if (Piece (OldFrom) == pKing)
+      King = To;
+    OldTo = Board [To.x][To.y];
+    sm = MovePiece (From, To);
+    OK = !SquareAttacked (King, !PlayWhite);
+    UnmovePiece (From, To, OldFrom, OldTo, sm);
+    return OK;
+  }
+
+bool PgnMove (const char *San, int Length, bool PlayWhite, _Coord *From_, _Coord *To_, _Piece *Crown)
+  {
+    _Piece Pce, p;
+    _Coord To, From, FromFound, King, *m;
+    _Coord Moves [64];
+    int FromX, FromY, Found;
+    //
+    // Trim check, mate and annotation marks
+    while (Length > 0 && (San [Length - 1] == '+' || San [Length - 1] == '#' || San [Length - 1] == '!' || San [Length - 1] == '?'))
+      Length--;
+    if (Length < 2)
+      return false;
+    *Crown = pEmpty;
+    FromX = -1;
+    FromY = -1;
+    if (San [0] == 'O' || San [0] == '0')   // Castle
+      {
+        Pce = pKing;
+        FromX = 4;
+        FromY = FirstY [PlayWhite];
+        To.y = FromY;
+        if (Length >= 5)
+          To.x = 2;   // O-O-O
+        else
+          To.x = 6;   // O-O
+      }
+    else
+      {
+        Pce = PgnPieceLetter (San [0]);
+        if (Pce == pEmpty)
+          Pce = pPawn;
+        else
+          {
+            San++;
+            Length--;
+          }
+        // Promotion at the end
+        if (Pce == pPawn && Length >= 3 && PgnPieceLetter (San [Length - 1]) != pEmpty)
+          {
+            *Crown = PgnPieceLetter (San [Length - 1]);
+            Length--;
+            if (San [Length - 1] == '=')
+              Length--;
+          }
+        if (Length < 2)
+          return false;
+        // Destination is the last 2 characters. Anything before it is the From file and / or rank
+        To.x = San [Length - 2] - 'a';
+        To.y = San [Length - 1] - '1';
+        if (To.x < 0 || To.x > 7 || To.y < 0 || To.y > 7)
+          return false;
+        Length -= 2;
+        while (Length > 0)
+          {
+            if (*San >= 'a' && *San <= 'h')
+              FromX = *San - 'a';
+            else if (*San >= '1' && *San <= '8')
+              FromY = *San - '1';
+            else if (*San != 'x' && *San != ':' && *San != '-')
+              return false;
+            San++;
+            Length--;
+          }
+      }
+    // Find the piece that can make the move. A Pawn that doesn't say its file is pushed
+    if (Pce == pPawn && FromX < 0)
+      FromX = To.x;
+    if (!FindKing (PlayWhite, &King))
+      return false;
+    Found = 0;
+    for (From.y = Max (FromY, 0); From.y <= ((FromY < 0) ? 7 : FromY); From.y++)
+      for (From.x = Max (FromX, 0); From.x <= ((FromX < 0) ? 7 : FromX); From.x++)
+        {
+          p = Board [From.x][From.y];
+          if (Piece (p) != Pce || PieceWhite (p) != PlayWhite)
+            continue;
+          GetPieceMoves (From, Moves);
+          for (m = Moves; m->x >= 0; m++)
+            if (m->x == To.x && m->y == To.y)
+              {
+                if (PgnLegal (PlayWhite, King, From, To))
+                  {
+                    FromFound = From;
+                    Found++;
+                  }
+                break;
+              }
+        }
+    if (Found != 1)
+      return false;
+    *From_ = FromFound;
+    *To_ = To;
+    return true;
+  }
+
+// Play a resolved move. Under promotion replaces the Queen MovePiece gives
+
+void PgnPlay (_Coord From, _Coord To, _Piece Crown)
+  {
+    _SpecialMove sm;
+    //
+    sm = MovePiece (From, To);
+    if (sm == smCrown && Crown != pEmpty && Crown != pQueen)
+      Board [To.x][To.y] = (_Piece) (Board [To.x][To.y] - pQueen + Crown);
+  }
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PgnReadSlice: Replay all the games in one slice of the file
+//
+
+// Result token, or PgnUnknown if it isn't one
+
+int PgnResult (const char *s, int Length)
+  {
+    if (Length == 3 && s [0] == '1' && s [1] == '-' && s [2] == '0')
+      return 2;
+    if (Length == 3 && s [0] == '0' && s [1] == '-' && s [2] == '1')
+      return 0;
+    if (Length == 7 && s [0] == '1' && s [1] == '/' && s [2] == '2')
+      return 1;
+    return PgnUnknown;
+  }
+
+bool PgnTokenIs (const char *s, const char *Stop, const char *Token)
+  {
+    while (*Token)
+      if (s >= Stop || *s++ != *Token++)
+        return false;
+    return true;
+  }
+
+void PgnReadSlice (void *Param)
+  {
+    _PgnSlice *Slice;
+    const char *s, *Stop, *t, *FEN;
+    char FENText [100];
+    int Length, Depth, Result, Moves, i;
+    bool InGame, Error, PlayWhite;
+    _Coord From, To;
+    _Piece Crown;
+    //
+    Slice = (_PgnSlice *) Param;
+    s = Slice->Start;
+    Stop = Slice->Stop;
+    InGame = false;
+    Error = false;
+    FEN = NULL;
+    Result = PgnUnknown;
+    Moves = 0;
+    PlayWhite = true;
+    while (true)
+      {
+        // Skip white space
+        while (s < Stop && (*s == ' ' || *s == '\n' || *s == '\r' || *s == '\t'))
+          s++;
+        if (s >= Stop || *s == '[' || *s == '*')   // Tags start the next game
+          {
+            if (InGame)
+              {
+                Slice->Sink->GameEnd (Slice->User, Result, Moves, Error);
+                Slice->Games++;
+                Slice->Errors += Error;
+                InGame = false;
+                FEN = NULL;
+                Result = PgnUnknown;
+              }
+            if (s >= Stop)
+              break;
+            if (*s == '*')
+              {
+                s++;
+                continue;
+              }
+            // Tag pair
+            if (PgnTokenIs (s, Stop, "[Result \""))
+              {
+                for (t = s + 9; t < Stop && *t != '"' && *t != '\n'; t++)
+                  ;
+                Result = PgnResult (s + 9, t - s - 9);
+              }
+            else if (PgnTokenIs (s, Stop, "[FEN \""))
+              FEN = s + 6;
+            while (s < Stop && *s != '\n')
+              s++;
+            continue;
+          }
+        // Comments and variations
+        if (*s == '{')
+          {
+            while (s < Stop && *s != '}')
+              s++;
+            s++;
+            continue;
+          }
+        if (*s == ';' || *s == '%')
+          {
+            while (s < Stop && *s != '\n')
+              s++;
+            continue;
+          }
+        if (*s == '(')
+          {
+            Depth = 0;
+            for (; s < Stop; s++)
+              if (*s == '(')
+                Depth++;
+              else if (*s == ')' && --Depth == 0)
+                break;
+            s++;
+            continue;
+          }
+        // A token
+        t = s;
+        while (s < Stop && *s != ' ' && *s != '\n' && *s != '\r' && *s != '\t' && *s != '{' && *s != '(' && *s != ')' && *s != ';')
+          s++;
+        Length = s - t;
+        if (!InGame)   // First move: set up the Board
+          {
+            InGame = true;
+            Error = false;
+            Moves = 0;
+            PlayWhite = true;
+            BoardReset ();
+            if (FEN != NULL)
+              {
+                for (i = 0; i < (int) sizeof (FENText) - 1 && FEN + i < Stop && FEN [i] != '"'; i++)
+                  FENText [i] = FEN [i];
+                FENText [i] = 0;
+                if (!BoardFromFEN (FENText, &PlayWhite))
+                  Error = true;
+              }
+            InCheck (PlayWhite);
+          }
+        if (PgnResult (t, Length) != PgnUnknown)   // Game end
+          {
+            Result = PgnResult (t, Length);
+            Slice->Sink->GameEnd (Slice->User, Result, Moves, Error);
+            Slice->Games++;
+            Slice->Errors += Error;
+            InGame = false;
+            FEN = NULL;
+            Result = PgnUnknown;
+            continue;
+          }
+        if (*t == '$' || Error)   // NAG, or after an error skip to the game end
+          continue;
+        // Move number: "12." "12..." or run on "12.e4"
+        for (i = 0; i < Length && t [i] >= '0' && t [i] <= '9'; i++)
+          ;
+        if (i < Length && t [i] == '.')
+          {
+            while (i < Length && t [i] == '.')
+              i++;
+            t += i;
+            Length -= i;
+          }
+        if (Length == 0)
+          continue;
+        if (PgnMove (t, Length, PlayWhite, &From, &To, &Crown))
+          {
+            Slice->Sink->Position (Slice->User, PlayWhite, From, To, Result);
+            PgnPlay (From, To, Crown);
+            PlayWhite = !PlayWhite;
+            Moves++;
+            Slice->Moves++;
+          }
+        else
+          Error = true;
+      }
+  }
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PgnRead: Replay every game in a PGN file
+//
+// The file is split into Threads slices, each starting at a "[Event " tag. Sink is called from all
+// the threads, Users [i] (UserSize bytes each) is given to slice i.
+// Returns false if the file can't be read. Counts are added up in Total.
+
+bool PgnRead (const char *FileName, const _PgnSink *Sink, void *Users, int UserSize, int Threads, _PgnSlice *Total)
+  {
+    _FileMap Map;
+    _PgnSlice Slices [256];
+    const char *Split, *End_;
+    int i;
+    //
+    if (!FileMapOpen (FileName, &Map))
+      return false;
+    if (Threads > 256)
+      Threads = 256;
+    End_ = Map.Data + Map.Size;
+    for (i = 0; i < Threads; i++)
+      {
+        Slices [i].Start = (i == 0) ? Map.Data : Slices [i - 1].Stop;
+        Split = Map.Data + Map.Size * (i + 1) / Threads;
+        if (Split < Slices [i].Start)
+          Split = Slices [i].Start;
+        if (i < Threads - 1)
+          while (Split < End_ && !((Split == Map.Data || Split [-1] == '\n') && PgnTokenIs (Split, End_, "[Event ")))
+            Split++;
+        else
+          Split = End_;
+        Slices [i].Stop = Split;
+        Slices [i].Sink = Sink;
+        Slices [i].User = (char *) Users + i * UserSize;
+        Slices [i].Games = 0;
+        Slices [i].Moves = 0;
+        Slices [i].Errors = 0;
+      }
+    ThreadsParallel (PgnReadSlice, Slices, sizeof (_PgnSlice), Threads);
+    Total->Games = 0;
+    Total->Moves = 0;
+    Total->Errors = 0;
+    for (i = 0; i < Threads; i++)
+      {
+        Total->Games += Slices [i].Games;
+        Total->Moves += Slices [i].Moves;
+        Total->Errors += Slices [i].Errors;
+      }
+    FileMapClose (&Map);
+    return true;
+  }
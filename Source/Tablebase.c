@@ -0,0 +1,540 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// TABLEBASES
+//
+// Author: Stewart Tunbridge, Pi Micros
+// Email:  stewarttunbridge@gmail.com
+// Copyright (c) 2025 Stewart Tunbridge, Pi Micros
+//
+// Distance to mate for every position of an ending of up to 5 pieces, in files made by chess-tbgen
+// and probed by the search through memory mapping.
+//
+// A table is named by its pieces, White's then Black's, eg KQKR. White is always the stronger side,
+// the caller turns the board round if Black is. Pieces are letters here, K Q R B N P, White's in
+// capitals, so this doesn't need Chess.c.
+//
+// The index of a position is
+//   side to move, the two Kings, then each other piece's square (a Pawn's from a2 to h7, so 48)
+// The Kings are kept apart and moved by symmetry: with no Pawns the White King is put in the
+// a1-d1-d4 triangle (462 pairs), with Pawns on files a-d (1806 pairs).
+//
+// Each position is a byte:
+//   0       draw
+//   1..254  the side to move mates, or is mated, in Value - 1 plies. Odd plies => it mates
+//   255     not a legal position
+//
+// The file is a _TablebaseHeader, an offset for each block of TablebaseBlock positions and one
+// after the last, then the blocks. Each block is coded on its own, so a probe decodes just the one,
+// as a byte then what it says:
+//   0..127    that many + 1 values follow
+//   128..255  copy that many - 125 values, from the low byte then high byte + 1 back. A run of one
+//             value is a copy from 1 back
+// Illegal positions are never asked for, so they take the value before them, to lengthen matches.
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <string.h>
+
+#define TablebaseMagic 0x31425443   // "CTB1"
+#define TablebasePiecesMax 5
+#define TablebaseBlock 4096
+#define TablebasesMax 256
+
+#define tvDraw 0
+#define tvIllegal 255
+#define TablebasePlies(v) ((v) - 1)
+#define TablebaseMates(v) (((v) & 1) == 0)   // the side to move mates
+
+typedef struct
+  {
+    unsigned int Magic;
+    char Name [8];
+    unsigned int Blocks;
+    longint Size;   // positions
+  } _TablebaseHeader;
+
+typedef struct
+  {
+    char Name [8];
+    int n, Whites;   // pieces, of them White's
+    char Kind [TablebasePiecesMax];   // White's then Black's, each King first
+    bool Pawns;
+    longint Size;   // positions
+    unsigned char *Data;   // all the positions, while generating
+    _FileMap Map;   // or the file
+    const unsigned int *Offsets;
+    const unsigned char *Blocks;
+  } _Tablebase;
+
+_Tablebase Tablebases [TablebasesMax];
+int TablebasesN = 0;
+
+const char TablebaseKinds [] = "KQRBNP";
+int TablebaseKindValue [] = {0, 9, 5, 3, 3, 1};
+
+// The King pairs: [Pawns][White King][Black King] => index, -1 if not kept. And back
+int TablebaseKK [2][64][64];
+unsigned char TablebaseKKSquares [2][1806][2];
+int TablebaseKKN [2];
+
+#define tbX(s) ((s) & 7)
+#define tbY(s) ((s) >> 3)
+
+void TablebaseInit (void)
+  {
+    int p, w, b;
+    bool Keep;
+    //
+    for (p = 0; p < 2; p++)
+      {
+        TablebaseKKN [p] = 0;
+        for (w = 0; w < 64; w++)
+          for (b = 0; b < 64; b++)
+            {
+              if (p)
+                Keep = tbX (w) <= 3;
+              else
+                Keep = tbX (w) <= 3 && tbY (w) <= tbX (w) && (tbY (w) < tbX (w) || tbY (b) <= tbX (b));
+              if (Abs (tbX (w) - tbX (b)) <= 1 && Abs (tbY (w) - tbY (b)) <= 1)   // touching, or the same
+                Keep = false;
+              TablebaseKK [p][w][b] = Keep ? TablebaseKKN [p] : -1;
+              if (Keep)
+                {
+                  TablebaseKKSquares [p][TablebaseKKN [p]][0] = w;
+                  TablebaseKKSquares [p][TablebaseKKN [p]][1] = b;
+                  TablebaseKKN [p]++;
+                }
+            }
+      }
+  }
+
+// A piece's place in the index: Pawns 48 squares, others 64
+
+#define TablebaseRange(Kind) ((Kind) == 'P' ? 48 : 64)
+
+// Name a material, and whether the colours have to be swapped for it. Pce are letters, White's in
+// capitals. Returns false if it isn't one for a table
+
+bool TablebaseName (const char *Pce, int n, char *Name, bool *Swap)
+  {
+    char Side [2][TablebasePiecesMax + 1];
+    int Count [2], Value [2], i, k, c;
+    const char *Kind;
+    //
+    if (n > TablebasePiecesMax)
+      return false;
+    for (c = 0; c < 2; c++)
+      {
+        Count [c] = 0;
+        Value [c] = 0;
+        for (Kind = TablebaseKinds; *Kind; Kind++)   // in K Q R B N P order
+          for (i = 0; i < n; i++)
+            if (UpCase (Pce [i]) == *Kind && (Pce [i] == *Kind) == (c == 0))
+              {
+                Side [c][Count [c]++] = *Kind;
+                Value [c] += TablebaseKindValue [Kind - TablebaseKinds];
+              }
+        Side [c][Count [c]] = 0;
+        if (Count [c] == 0 || Side [c][0] != 'K' || (Count [c] > 1 && Side [c][1] == 'K'))
+          return false;
+      }
+    *Swap = Value [1] > Value [0] || (Value [1] == Value [0] && strcmp (Side [1], Side [0]) < 0);
+    k = *Swap;
+    strcpy (Name, Side [k]);
+    strcat (Name, Side [!k]);
+    return true;
+  }
+
+// Set up t for the table called Name
+
+bool TablebaseSetup (_Tablebase *t, const char *Name)
+  {
+    int i;
+    //
+    memset (t, 0, sizeof (_Tablebase));
+    t->n = StrLength (Name);
+    if (t->n < 2 || t->n > TablebasePiecesMax || Name [0] != 'K')
+      return false;
+    strcpy (t->Name, Name);
+    t->Whites = 0;
+    for (i = 0; i < t->n; i++)
+      {
+        t->Kind [i] = Name [i];
+        if (i > 0 && Name [i] == 'K')
+          t->Whites = i;
+        if (Name [i] == 'P')
+          t->Pawns = true;
+      }
+    if (t->Whites == 0)
+      return false;
+    t->Size = 2 * TablebaseKKN [t->Pawns];
+    for (i = 1; i < t->n; i++)
+      if (i != t->Whites)
+        t->Size *= TablebaseRange (t->Kind [i]);
+    return true;
+  }
+
+// Index of a position, Sq in the order of t->Kind. -1 if it can't be one
+
+longint TablebaseIndex (const _Tablebase *t, bool WhiteToMove, const int *Sq_)
+  {
+    int Sq [TablebasePiecesMax], i, Flip, kk;
+    longint Index;
+    //
+    for (i = 0; i < t->n; i++)
+      Sq [i] = Sq_ [i];
+    Flip = (tbX (Sq [0]) > 3) ? 7 : 0;
+    if (!t->Pawns)
+      {
+        if (tbY (Sq [0]) > 3)
+          Flip |= 0x38;
+      }
+    for (i = 0; i < t->n; i++)
+      Sq [i] ^= Flip;
+    if (!t->Pawns)   // flip on the a1-h8 diagonal?
+      if (tbY (Sq [0]) > tbX (Sq [0]) || (tbY (Sq [0]) == tbX (Sq [0]) && tbY (Sq [t->Whites]) > tbX (Sq [t->Whites])))
+        for (i = 0; i < t->n; i++)
+          Sq [i] = tbX (Sq [i]) * 8 + tbY (Sq [i]);
+    kk = TablebaseKK [t->Pawns][Sq [0]][Sq [t->Whites]];
+    if (kk < 0)
+      return -1;
+    Index = !WhiteToMove * TablebaseKKN [t->Pawns] + kk;
+    for (i = 1; i < t->n; i++)
+      if (i != t->Whites)
+        if (t->Kind [i] == 'P')
+          {
+            if (Sq [i] < 8 || Sq [i] >= 56)
+              return -1;
+            Index = Index * 48 + Sq [i] - 8;
+          }
+        else
+          Index = Index * 64 + Sq [i];
+    return Index;
+  }
+
+// The position at Index
+
+void TablebasePosition (const _Tablebase *t, longint Index, bool *WhiteToMove, int *Sq)
+  {
+    int i, r, kk;
+    //
+    for (i = t->n - 1; i > 0; i--)
+      if (i != t->Whites)
+        {
+          r = TablebaseRange (t->Kind [i]);
+          Sq [i] = Index % r + (r == 48 ? 8 : 0);
+          Index /= r;
+        }
+    kk = Index % TablebaseKKN [t->Pawns];
+    *WhiteToMove = Index < TablebaseKKN [t->Pawns];
+    Sq [0] = TablebaseKKSquares [t->Pawns][kk][0];
+    Sq [t->Whites] = TablebaseKKSquares [t->Pawns][kk][1];
+  }
+
+// Decode a block into Out, which has Room for the whole block, till it has Need values. Returns how
+// many it has: fewer if the block ends first or is corrupt
+
+int TablebaseUnpack (const unsigned char *r, const unsigned char *End, unsigned char *Out, int Need, int Room)
+  {
+    int n, k, Back;
+    //
+    n = 0;
+    while (r < End && n < Need)
+      if (*r < 128)
+        {
+          k = *r + 1;
+          if (n + k > Room || End - r < k + 1)
+            break;
+          memcpy (Out + n, r + 1, k);
+          r += k + 1;
+          n += k;
+        }
+      else
+        {
+          k = *r - 125;
+          if (End - r < 3)
+            break;
+          Back = r [1] + r [2] * 256 + 1;
+          if (n + k > Room || Back > n)
+            break;
+          r += 3;
+          for (; k > 0; k--, n++)
+            Out [n] = Out [n - Back];
+        }
+    return n;
+  }
+
+// The value at Index. -1 if its block is corrupt
+
+int TablebaseValue (const _Tablebase *t, longint Index)
+  {
+    unsigned char Out [TablebaseBlock];
+    longint b;
+    int i;
+    //
+    if (t->Data)
+      return __atomic_load_n (&t->Data [Index], __ATOMIC_RELAXED);
+    b = Index / TablebaseBlock;
+    i = Index % TablebaseBlock;
+    if (TablebaseUnpack (t->Blocks + t->Offsets [b], t->Blocks + t->Offsets [b + 1], Out, i + 1, TablebaseBlock) <= i)
+      return -1;
+    return Out [i];
+  }
+
+_Tablebase *TablebaseFind (const char *Name)
+  {
+    int i;
+    //
+    for (i = 0; i < TablebasesN; i++)
+      if (strcmp (Tablebases [i].Name, Name) == 0)
+        return &Tablebases [i];
+    return NULL;
+  }
+
+// TablebaseProbe: The value of a position of n pieces, Pce as letters (White's in capitals) on Sq
+// (y * 8 + x). -1 if there's no table for it, or it can't be read
+
+int TablebaseProbe (int n, const char *Pce, const int *Sq, bool WhiteToMove)
+  {
+    char Name [8];
+    bool Swap, Used [TablebasePiecesMax];
+    int Order [TablebasePiecesMax], i, j;
+    _Tablebase *t;
+    longint Index;
+    //
+    if (!TablebaseName (Pce, n, Name, &Swap) || (t = TablebaseFind (Name)) == NULL)
+      return -1;
+    // Put the pieces in the table's order, turning the board round if need be
+    for (i = 0; i < n; i++)
+      Used [i] = false;
+    for (j = 0; j < n; j++)
+      for (i = 0; i < n; i++)
+        if (!Used [i] && UpCase (Pce [i]) == t->Kind [j] && ((Pce [i] == t->Kind [j]) != Swap) == (j < t->Whites))
+          {
+            Used [i] = true;
+            Order [j] = Swap ? Sq [i] ^ 0x38 : Sq [i];
+            break;
+          }
+    Index = TablebaseIndex (t, WhiteToMove != Swap, Order);
+    if (Index < 0)
+      return -1;
+    return TablebaseValue (t, Index);
+  }
+
+// Code a block of n values into Out. Returns the bytes. Matches are found through a hash of the
+// next 3 values, trying the latest 64 places each
+
+#define TablebaseHash(p) ((((p) [0] << 8) ^ ((p) [1] << 4) ^ (p) [2]) & 0xFFF)
+
+int TablebasePack (const unsigned char *In, int n, unsigned char *Out)
+  {
+    int Head [0x1000], Prev [TablebaseBlock];
+    int i, j, k, Tries, Len, Best, Back, Literals;
+    unsigned char *o;
+    //
+    for (i = 0; i < 0x1000; i++)
+      Head [i] = -1;
+    o = Out;
+    Literals = 0;   // at o - Literals - 1 is their count
+    i = 0;
+    while (i < n)
+      {
+        Best = 0;
+        Back = 0;
+        if (i + 3 <= n)
+          for (j = Head [TablebaseHash (In + i)], Tries = 0; j >= 0 && Tries < 64; j = Prev [j], Tries++)
+            {
+              for (Len = 0; i + Len < n && Len < 130 && In [j + Len] == In [i + Len]; Len++)
+                ;
+              if (Len > Best)
+                {
+                  Best = Len;
+                  Back = i - j;
+                }
+            }
+        if (Best < 3)
+          Best = 1;
+        for (k = i; k < i + Best; k++)
+          if (k + 3 <= n)
+            {
+              Prev [k] = Head [TablebaseHash (In + k)];
+              Head [TablebaseHash (In + k)] = k;
+            }
+        if (Best >= 3)
+          {
+            *o++ = Best + 125;
+            *o++ = (Back - 1) & 0xFF;
+            *o++ = (Back - 1) >> 8;
+            Literals = 0;
+          }
+        else
+          {
+            if (Literals == 0 || Literals == 128)
+              {
+                *o++ = 0;
+                Literals = 0;
+              }
+            else
+              o [-Literals - 1]++;
+            *o++ = In [i];
+            Literals++;
+          }
+        i += Best;
+      }
+    return o - Out;
+  }
+
+// Write t->Data to FileName, compressed. Returns the bytes written, 0 if it fails
+
+longint TablebaseWrite (const _Tablebase *t, const char *FileName)
+  {
+    FILE *f;
+    _TablebaseHeader Header;
+    unsigned int *Offsets, Blocks, b;
+    unsigned char *Packed, In [TablebaseBlock];
+    longint i, Bytes;
+    int n;
+    //
+    Blocks = (t->Size + TablebaseBlock - 1) / TablebaseBlock;
+    Offsets = (unsigned int *) malloc ((Blocks + 1) * sizeof (unsigned int));
+    Packed = (unsigned char *) malloc (t->Size + t->Size / 128 + Blocks + 1);   // as big as it can get
+    f = fopen (FileName, "wb");
+    if (Offsets == NULL || Packed == NULL || f == NULL)
+      {
+        free (Offsets);
+        free (Packed);
+        if (f)
+          fclose (f);
+        return 0;
+      }
+    Bytes = 0;
+    for (b = 0; b < Blocks; b++)
+      {
+        Offsets [b] = Bytes;
+        n = Min ((longint) TablebaseBlock, t->Size - (longint) b * TablebaseBlock);
+        for (i = 0; i < n; i++)
+          {
+            In [i] = t->Data [(longint) b * TablebaseBlock + i];
+            if (In [i] == tvIllegal)   // any value will do
+              In [i] = (i > 0) ? In [i - 1] : tvDraw;
+          }
+        Bytes += TablebasePack (In, n, Packed + Bytes);
+      }
+    Offsets [Blocks] = Bytes;
+    memset (&Header, 0, sizeof (Header));
+    Header.Magic = TablebaseMagic;
+    strcpy (Header.Name, t->Name);
+    Header.Blocks = Blocks;
+    Header.Size = t->Size;
+    fwrite (&Header, sizeof (Header), 1, f);
+    fwrite (Offsets, sizeof (unsigned int), Blocks + 1, f);
+    fwrite (Packed, 1, Bytes, f);
+    fclose (f);
+    free (Offsets);
+    free (Packed);
+    return sizeof (Header) + (Blocks + 1) * sizeof (unsigned int) + Bytes;
+  }
+
+// Map the table called Name from FileName. Unpack it into t->Data too if asked. Returns NULL if
+// it can't, or the file is short or its offsets don't fit it
+
+_Tablebase *TablebaseLoad (const char *Name, const char *FileName, bool Unpack)
+  {
+    _Tablebase *t;
+    const _TablebaseHeader *Header;
+    longint b, Blocks, n;
+    bool OK;
+    //
+    if (TablebasesN >= TablebasesMax)
+      return NULL;
+    t = &Tablebases [TablebasesN];
+    if (!TablebaseSetup (t, Name) || !FileMapOpen (FileName, &t->Map))
+      return NULL;
+    Header = (const _TablebaseHeader *) t->Map.Data;
+    Blocks = (t->Size + TablebaseBlock - 1) / TablebaseBlock;
+    OK = t->Map.Size >= (longint) sizeof (_TablebaseHeader) && Header->Magic == TablebaseMagic && strcmp (Header->Name, Name) == 0
+         && Header->Size == t->Size && Header->Blocks == Blocks
+         && t->Map.Size >= (longint) (sizeof (_TablebaseHeader) + (Blocks + 1) * sizeof (unsigned int));
+    if (OK)
+      {
+        t->Offsets = (const unsigned int *) (t->Map.Data + sizeof (_TablebaseHeader));
+        t->Blocks = (const unsigned char *) (t->Offsets + Blocks + 1);
+        OK = t->Offsets [0] == 0 && t->Offsets [Blocks] <= t->Map.Size - ((const char *) t->Blocks - t->Map.Data);
+        for (b = 0; OK && b < Blocks; b++)
+          OK = t->Offsets [b] < t->Offsets [b + 1];
+      }
+    if (OK && Unpack)
+      {
+        t->Data = (unsigned char *) malloc (t->Size);
+        OK = t->Data != NULL;
+        for (b = 0; OK && b < Blocks; b++)
+          {
+            n = Min ((longint) TablebaseBlock, t->Size - b * TablebaseBlock);
+            OK = TablebaseUnpack (t->Blocks + t->Offsets [b], t->Blocks + t->Offsets [b + 1], t->Data + b * TablebaseBlock, n, n) == n;
+          }
+        if (!OK)
+          {
+            free (t->Data);
+            t->Data = NULL;
+          }
+      }
+    if (!OK || Unpack)
+      FileMapClose (&t->Map);
+    if (!OK)
+      return NULL;
+    TablebasesN++;
+    return t;
+  }
+
+// TablebaseOpen: Map every table there's a file for in Dir, <Name>.ctb. Returns how many
+//
+// Every material of up to 5 pieces is tried. Name holds White's pieces, then Black's once Black is
+// set, each in K Q R B N P order
+
+int TablebaseOpenFrom (const char *Dir, char *Name, int n, int Kind, bool Black)
+  {
+    char Pce [TablebasePiecesMax], Canon [8], FileName [1024];
+    int i, k, Found;
+    bool Swap;
+    //
+    Found = 0;
+    if (Black)
+      {
+        k = strrchr (Name, 'K') - Name;   // Black's King
+        for (i = 0; i < n; i++)
+          Pce [i] = (i < k) ? Name [i] : Name [i] - 'A' + 'a';
+        if (TablebaseName (Pce, n, Canon, &Swap) && !Swap && strcmp (Canon, Name) == 0 && TablebaseFind (Canon) == NULL)
+          {
+            snprintf (FileName, sizeof (FileName), "%s/%s.ctb", Dir, Canon);
+            if (TablebaseLoad (Canon, FileName, false))
+              Found++;
+          }
+      }
+    if (n < TablebasePiecesMax)
+      {
+        for (i = Kind; TablebaseKinds [i]; i++)
+          {
+            Name [n] = TablebaseKinds [i];
+            Name [n + 1] = 0;
+            Found += TablebaseOpenFrom (Dir, Name, n + 1, i, Black);
+          }
+        if (!Black)   // on to Black's
+          {
+            Name [n] = 'K';
+            Name [n + 1] = 0;
+            Found += TablebaseOpenFrom (Dir, Name, n + 1, 1, true);
+          }
+      }
+    Name [n] = 0;
+    return Found;
+  }
+
+int TablebaseOpen (const char *Dir)
+  {
+    char Name [TablebasePiecesMax + 1];
+    //
+    Name [0] = 'K';
+    Name [1] = 0;
+    return TablebaseOpenFrom (Dir, Name, 1, 1, false);
+  }
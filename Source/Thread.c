@@ -0,0 +1,200 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// THREADS
+//
+// Author: Stewart Tunbridge, Pi Micros
+// Email:  stewarttunbridge@gmail.com
+// Copyright (c) 2025 Stewart Tunbridge, Pi Micros
+//
+// Minimal threads for Linux and Windows. The engine state in Chess.c is thread_local so each
+// thread has its own Board to work on.
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifdef _Windows
+  #include <windows.h>
+  typedef HANDLE _Thread;
+  typedef CRITICAL_SECTION _Lock;
+  typedef CONDITION_VARIABLE _Signal;
+#else
+  #include <pthread.h>
+  #include <unistd.h>
+  typedef pthread_t _Thread;
+  typedef pthread_mutex_t _Lock;
+  typedef pthread_cond_t _Signal;
+#endif
+
+typedef void (*_ThreadFunc) (void *Param);
+
+typedef struct
+  {
+    _ThreadFunc Func;
+    void *Param;
+  } _ThreadStart;
+
+#ifdef _Windows
+  DWORD WINAPI ThreadEntry (LPVOID Start_)
+#else
+  void *ThreadEntry (void *Start_)
+#endif
+  {
+    _ThreadStart Start;
+    //
+    Start = *(_ThreadStart *) Start_;
+    free (Start_);
+    Start.Func (Start.Param);
+    return 0;
+  }
+
+// Number of CPU cores available
+
+int ThreadCount (void)
+  {
+    int n;
+    //
+    #ifdef _Windows
+      SYSTEM_INFO Info;
+      GetSystemInfo (&Info);
+      n = Info.dwNumberOfProcessors;
+    #else
+      n = sysconf (_SC_NPROCESSORS_ONLN);
+    #endif
+    if (n < 1)
+      n = 1;
+    return n;
+  }
+
+// Start Func (Param) running in a new thread
+
+bool ThreadStart (_Thread *Thread, _ThreadFunc Func, void *Param)
+  {
+    _ThreadStart *Start;
+    //
+    Start = (_ThreadStart *) malloc (sizeof (_ThreadStart));
+    if (Start == NULL)
+      return false;
+    Start->Func = Func;
+    Start->Param = Param;
+    #ifdef _Windows
+      *Thread = CreateThread (NULL, 0, ThreadEntry, Start, 0, NULL);
+      if (*Thread != NULL)
+        return true;
+    #else
+      if (pthread_create (Thread, NULL, ThreadEntry, Start) == 0)
+        return true;
+    #endif
+    free (Start);
+    return false;
+  }
+
+// Wait for a thread to finish
+
+void ThreadWait (_Thread Thread)
+  {
+    #ifdef _Windows
+      WaitForSingleObject (Thread, INFINITE);
+      CloseHandle (Thread);
+    #else
+      pthread_join (Thread, NULL);
+    #endif
+  }
+
+// Let other threads run for ms milliseconds
+
+void ThreadSleep (int ms)
+  {
+    #ifdef _Windows
+      Sleep (ms);
+    #else
+      usleep (ms * 1000);
+    #endif
+  }
+
+// Run Func on each of n Params (each ParamSize bytes) in parallel and wait for them all.
+// The last one runs in the calling thread. Anything that fails to start also runs here.
+
+void ThreadsParallel (_ThreadFunc Func, void *Params, int ParamSize, int n)
+  {
+    _Thread Threads [256];
+    bool Started [256];
+    int i;
+    //
+    if (n > 256)
+      n = 256;
+    for (i = 0; i < n - 1; i++)
+      Started [i] = ThreadStart (&Threads [i], Func, (char *) Params + i * ParamSize);
+    Func ((char *) Params + (n - 1) * ParamSize);
+    for (i = 0; i < n - 1; i++)
+      if (Started [i])
+        ThreadWait (Threads [i]);
+      else
+        Func ((char *) Params + i * ParamSize);
+  }
+
+
+// Locks: only one thread at a time between Lock and Unlock
+
+void LockInit (_Lock *L)
+  {
+    #ifdef _Windows
+      InitializeCriticalSection (L);
+    #else
+      pthread_mutex_init (L, NULL);
+    #endif
+  }
+
+void Lock (_Lock *L)
+  {
+    #ifdef _Windows
+      EnterCriticalSection (L);
+    #else
+      pthread_mutex_lock (L);
+    #endif
+  }
+
+void Unlock (_Lock *L)
+  {
+    #ifdef _Windows
+      LeaveCriticalSection (L);
+    #else
+      pthread_mutex_unlock (L);
+    #endif
+  }
+
+// Signals: wait, holding L, until another thread signals. Check the condition again after, the
+// wait may end early
+
+void SignalInit (_Signal *S)
+  {
+    #ifdef _Windows
+      InitializeConditionVariable (S);
+    #else
+      pthread_cond_init (S, NULL);
+    #endif
+  }
+
+void SignalWait (_Signal *S, _Lock *L)
+  {
+    #ifdef _Windows
+      SleepConditionVariableCS (S, L, INFINITE);
+    #else
+      pthread_cond_wait (S, L);
+    #endif
+  }
+
+// Wake one waiting thread, or all of them
+
+void SignalWake (_Signal *S, bool All = false)
+  {
+    #ifdef _Windows
+      if (All)
+        WakeAllConditionVariable (S);
+      else
+        WakeConditionVariable (S);
+    #else
+      if (All)
+        pthread_cond_broadcast (S);
+      else
+        pthread_cond_signal (S);
+    #endif
+  }
@@ -0,0 +1,152 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// SEARCH TRACE
+//
+// Author: Stewart Tunbridge, Pi Micros
+// Email:  stewarttunbridge@gmail.com
+// Copyright (c) 2025 Stewart Tunbridge, Pi Micros
+//
+// Record every move BestMove searches to a binary file, for chess-trace to pick over.
+//
+// BestMove only calls TraceAdd when compiled with -DTRACE, so an ordinary build pays nothing. With
+// it, the thread that called TraceStart adds a record per move to a ring in memory, with no locks:
+// it is the only writer of TraceHead and the flush thread the only writer of TraceTail. The flush
+// thread writes the ring out as it fills. If it falls behind records are dropped (and counted)
+// rather than stall the search.
+//
+// Records come in post order: a move's record follows the records of the moves below it. So the
+// moves made in reply to a move at ply p are the records at ply p + 1 since the last record at a
+// ply <= p. The file is a _TraceHeader then the records.
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+
+#define TraceMagic 0x31525443   // "CTR1"
+
+typedef struct
+  {
+    unsigned int Magic;
+    unsigned int RecordSize;
+  } _TraceHeader;
+
+// Flags
+#define tfCutoff 0x01   // Score >= Beta: the moves after it weren't searched
+#define tfLeaf   0x02   // at DepthPlay, only the captures are searched below it
+#define tfSearch 0x80   // end of a search. Ply is DepthPlay, the move is the best, Nodes the total
+
+typedef struct
+  {
+    unsigned char Ply, Flags;
+    unsigned char From, To;   // squares, y * 8 + x
+    int Alpha, Beta, Score;
+    longint Nodes;   // moves searched for this move, including it
+  } _TraceRecord;
+
+#define TraceRingSize (1 << 20)   // records, 24MB
+
+thread_local bool TraceOn = false;
+_TraceRecord *TraceRing = NULL;
+unsigned int TraceHead, TraceTail;   // records added and written. Only ever increase
+bool TraceStopping;
+longint TraceRecords, TraceDropped;
+FILE *TraceFile;
+_Thread TraceThread;
+
+// Add a record. Only from the thread that called TraceStart
+
+void TraceAdd (int Ply, int Flags, int From, int To, int Alpha, int Beta, int Score, longint Nodes)
+  {
+    _TraceRecord *r;
+    //
+    if (TraceHead - __atomic_load_n (&TraceTail, __ATOMIC_ACQUIRE) >= TraceRingSize)
+      {
+        TraceDropped++;
+        return;
+      }
+    r = &TraceRing [TraceHead & (TraceRingSize - 1)];
+    r->Ply = Ply;
+    r->Flags = Flags;
+    r->From = From;
+    r->To = To;
+    r->Alpha = Alpha;
+    r->Beta = Beta;
+    r->Score = Score;
+    r->Nodes = Nodes;
+    TraceRecords++;
+    __atomic_store_n (&TraceHead, TraceHead + 1, __ATOMIC_RELEASE);
+  }
+
+// The flush thread: write out what's in the ring till stopped and empty
+
+void TraceFlush (void *Param)
+  {
+    unsigned int Head, Tail, n;
+    bool Stopping;
+    //
+    Tail = TraceTail;
+    while (true)
+      {
+        Stopping = __atomic_load_n (&TraceStopping, __ATOMIC_ACQUIRE);
+        Head = __atomic_load_n (&TraceHead, __ATOMIC_ACQUIRE);
+        if (Head == Tail)
+          {
+            if (Stopping)
+              break;
+            ThreadSleep (1);
+            continue;
+          }
+        // Up to the end of the ring, the rest next time round
+        n = Min (Head - Tail, TraceRingSize - (Tail & (TraceRingSize - 1)));
+        fwrite (&TraceRing [Tail & (TraceRingSize - 1)], sizeof (_TraceRecord), n, TraceFile);
+        Tail += n;
+        __atomic_store_n (&TraceTail, Tail, __ATOMIC_RELEASE);
+      }
+  }
+
+// Start tracing the calling thread's searches to FileName. Returns false if it can't
+
+bool TraceStart (const char *FileName)
+  {
+    _TraceHeader Header;
+    //
+    TraceFile = fopen (FileName, "wb");
+    if (TraceFile == NULL)
+      return false;
+    TraceRing = (_TraceRecord *) malloc (TraceRingSize * sizeof (_TraceRecord));
+    if (TraceRing == NULL)
+      {
+        fclose (TraceFile);
+        return false;
+      }
+    Header.Magic = TraceMagic;
+    Header.RecordSize = sizeof (_TraceRecord);
+    fwrite (&Header, sizeof (Header), 1, TraceFile);
+    TraceHead = 0;
+    TraceTail = 0;
+    TraceRecords = 0;
+    TraceDropped = 0;
+    TraceStopping = false;
+    if (!ThreadStart (&TraceThread, TraceFlush, NULL))
+      {
+        free (TraceRing);
+        fclose (TraceFile);
+        return false;
+      }
+    TraceOn = true;
+    return true;
+  }
+
+// Stop, and wait for the last records to be written
+
+void TraceStop (void)
+  {
+    if (!TraceOn)
+      return;
+    TraceOn = false;
+    __atomic_store_n (&TraceStopping, true, __ATOMIC_RELEASE);
+    ThreadWait (TraceThread);
+    fclose (TraceFile);
+    free (TraceRing);
+    TraceRing = NULL;
+  }
@@ -0,0 +1,495 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// TUNE THE EVALUATION WEIGHTS
+//
+// Author: Stewart Tunbridge, Pi Micros
+// Email:  stewarttunbridge@gmail.com
+// Copyright (c) 2025 Stewart Tunbridge, Pi Micros
+//
+// Texel tuning: fit PieceValue and the AnalysisScore weights to a set of positions with known game
+// results by minimising the error between the result and sigmoid (BoardScore).
+//
+// Position file: one position per line, FEN followed by the result, any of
+//   1-0  0-1  1/2-1/2  [1.0]  [0.5]  [0.0]  (White's point of view)
+// or a .pgn file: every position of every game with a result, or a .cpk file (chess-con Pack): every
+// position with a result.
+//
+// Positions are reduced to their _Features once, so each evaluation is a short dot product with no
+// Board involved. The error is summed over all cores.
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <math.h>
+#include <stdio.h>
+
+typedef struct
+  {
+    _Features Features;   // White's point of view
+    signed char Result;   // half points for White: 0, 1, 2
+  } _TunePosition;
+
+_TunePosition *TunePositions = NULL;
+int TunePositionsN = 0;
+
+// The weights being tuned. AnalysisScorePiece only scales Attack & AttackInd so is left alone
+
+typedef enum {twQueen, twRook, twBishop, twKnight, twPawn, twMove, twAttack, twAttackInd, twN} _TuneWeight;
+
+const char *TuneWeightName [] = {"Queen", "Rook", "Bishop", "Knight", "Pawn", "Move", "Attack", "AttackInd"};
+int TuneWeightStep [] = {100, 100, 100, 100, 100, 8, 8, 8};   // Starting step
+
+void TuneWeightsGet (int *w)
+  {
+    int i;
+    //
+    for (i = twQueen; i <= twPawn; i++)
+      w [i] = PieceValue [pQueen + i - twQueen];
+    w [twMove] = AnalysisScoreMove;
+    w [twAttack] = AnalysisScoreAttack;
+    w [twAttackInd] = AnalysisScoreAttackInd;
+  }
+
+void TuneWeightsSet (int *w)
+  {
+    int i;
+    //
+    for (i = twQueen; i <= twPawn; i++)
+      PieceValue [pQueen + i - twQueen] = w [i];
+    AnalysisScoreMove = w [twMove];
+    AnalysisScoreAttack = w [twAttack];
+    AnalysisScoreAttackInd = w [twAttackInd];
+  }
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Load the positions, one slice of the file per thread
+//
+
+typedef struct
+  {
+    char *Start, *Stop;   // lines to read
+    _TunePosition *Res;
+    int n;
+  } _TuneLoad;
+
+// Result from the rest of the line after the FEN. -1 if none
+
+int TuneResult (char *s, char *Stop)
+  {
+    while (s < Stop)
+      {
+        if (s [0] == '1' && s [1] == '/' && s [2] == '2')
+          return 1;
+        if (s [0] == '1' && s [1] == '-' && s [2] == '0')
+          return 2;
+        if (s [0] == '0' && s [1] == '-' && s [2] == '1')
+          return 0;
+        if (s [0] == '[')
+          {
+            if (s [1] == '1')
+              return 2;
+            if (s [1] == '0' && s [2] == '.' && s [3] == '5')
+              return 1;
+            if (s [1] == '0')
+              return 0;
+          }
+        s++;
+      }
+    return -1;
+  }
+
+void TuneLoadSlice (void *Param)
+  {
+    _TuneLoad *Load;
+    char *Line, *LineEnd, *s;
+    int Lines, Spaces, Result;
+    bool PlayWhite;
+    //
+    Load = (_TuneLoad *) Param;
+    Lines = 0;
+    for (s = Load->Start; s < Load->Stop; s++)
+      if (*s == '\n')
+        Lines++;
+    Load->Res = (_TunePosition *) malloc ((Lines + 1) * sizeof (_TunePosition));
+    Load->n = 0;
+    if (Load->Res == NULL)
+      return;
+    Line = Load->Start;
+    while (Line < Load->Stop)
+      {
+        LineEnd = Line;
+        while (LineEnd < Load->Stop && *LineEnd != '\n')
+          LineEnd++;
+        *LineEnd = 0;   // FEN reader stops here
+        // Result follows the first 4 FEN fields
+        s = Line;
+        Spaces = 0;
+        while (s < LineEnd && Spaces < 4)
+          if (*s++ == ' ')
+            Spaces++;
+        Result = TuneResult (s, LineEnd);
+        if (Result >= 0 && BoardFromFEN (Line, &PlayWhite))
+          {
+            BoardFeatures (true, &Load->Res [Load->n].Features);
+            Load->Res [Load->n].Result = Result;
+            Load->n++;
+          }
+        Line = LineEnd + 1;
+      }
+  }
+
+// Positions from the games in a PGN file, each with the game's result
+
+typedef struct
+  {
+    _TunePosition *Res;
+    int n, Size;
+  } _TunePgn;
+
+void TunePgnPosition (void *User, bool PlayWhite, _Coord From, _Coord To, int Result)
+  {
+    _TunePgn *Pgn;
+    _TunePosition *Res;
+    //
+    Pgn = (_TunePgn *) User;
+    if (Result == PgnUnknown)
+      return;
+    if (Pgn->n >= Pgn->Size)
+      {
+        Res = (_TunePosition *) realloc (Pgn->Res, (Pgn->Size * 2 + 4096) * sizeof (_TunePosition));
+        if (Res == NULL)
+          return;
+        Pgn->Res = Res;
+        Pgn->Size = Pgn->Size * 2 + 4096;
+      }
+    BoardFeatures (true, &Pgn->Res [Pgn->n].Features);
+    Pgn->Res [Pgn->n].Result = Result;
+    Pgn->n++;
+  }
+
+void TunePgnGameEnd (void *User, int Result, int Moves, bool Error)
+  {
+  }
+
+const _PgnSink TunePgnSink = {TunePgnPosition, TunePgnGameEnd};
+
+bool TuneLoadPgn (const char *FileName, int Threads)
+  {
+    _TunePgn Pgn [256];
+    _PgnSlice Total;
+    int i;
+    bool OK;
+    //
+    for (i = 0; i < Threads; i++)
+      {
+        Pgn [i].Res = NULL;
+        Pgn [i].n = 0;
+        Pgn [i].Size = 0;
+      }
+    OK = PgnRead (FileName, &TunePgnSink, Pgn, sizeof (_TunePgn), Threads, &Total);
+    TunePositionsN = 0;
+    for (i = 0; i < Threads; i++)
+      TunePositionsN += Pgn [i].n;
+    TunePositions = (_TunePosition *) malloc ((TunePositionsN + 1) * sizeof (_TunePosition));
+    TunePositionsN = 0;
+    for (i = 0; i < Threads; i++)
+      {
+        if (TunePositions != NULL && Pgn [i].n > 0)
+          MemMove (&TunePositions [TunePositionsN], Pgn [i].Res, Pgn [i].n * sizeof (_TunePosition));
+        TunePositionsN += Pgn [i].n;
+        free (Pgn [i].Res);
+      }
+    return OK && TunePositions != NULL;
+  }
+
+// Positions from a packed file. Each thread fills in its own share of TunePositions. Records that
+// won't unpack keep no result, so aren't kept
+
+void TunePackedPosition (void *User, const _Packed *p, longint Index, bool PlayWhite)
+  {
+    BoardFeatures (true, &TunePositions [Index].Features);
+    TunePositions [Index].Result = p->Result;
+  }
+
+bool TuneLoadPacked (const char *FileName, int Threads)
+  {
+    _PackedFile f;
+    char Users [256];
+    longint i;
+    //
+    if (!PackedOpen (FileName, &f))
+      return false;
+    TunePositions = (_TunePosition *) malloc ((f.Count + 1) * sizeof (_TunePosition));
+    if (TunePositions != NULL)
+      {
+        for (i = 0; i < f.Count; i++)
+          TunePositions [i].Result = PgnUnknown;
+        PackedForEach (f.Records, f.Count, TunePackedPosition, Users, 1, Threads);
+        TunePositionsN = 0;
+        for (i = 0; i < f.Count; i++)   // keep those with a result
+          if (TunePositions [i].Result != PgnUnknown)
+            TunePositions [TunePositionsN++] = TunePositions [i];
+      }
+    PackedCloseFile (&f);
+    return TunePositions != NULL;
+  }
+
+bool TuneLoad (const char *FileName, int Threads)
+  {
+    FILE *f;
+    long Size;
+    char *Text;
+    _TuneLoad Load [256];
+    int i;
+    //
+    if (Threads > 256)
+      Threads = 256;
+    i = StrLength (FileName);
+    if (i > 4 && (FileName [i - 4] == '.') && (UpCase (FileName [i - 3]) == 'P') && (UpCase (FileName [i - 2]) == 'G') && (UpCase (FileName [i - 1]) == 'N'))
+      return TuneLoadPgn (FileName, Threads);
+    if (i > 4 && (FileName [i - 4] == '.') && (UpCase (FileName [i - 3]) == 'C') && (UpCase (FileName [i - 2]) == 'P') && (UpCase (FileName [i - 1]) == 'K'))
+      return TuneLoadPacked (FileName, Threads);
+    f = fopen (FileName, "rb");
+    if (f == NULL)
+      return false;
+    fseek (f, 0, SEEK_END);
+    Size = ftell (f);
+    fseek (f, 0, SEEK_SET);
+    Text = (char *) malloc (Size + 1);
+    if (Text == NULL || (long) fread (Text, 1, Size, f) != Size)
+      {
+        fclose (f);
+        free (Text);
+        return false;
+      }
+    fclose (f);
+    Text [Size] = '\n';
+    // Split into slices on line boundaries
+    Load [0].Start = Text;
+    for (i = 0; i < Threads; i++)
+      {
+        if (i > 0)
+          Load [i].Start = Load [i - 1].Stop;
+        Load [i].Stop = Text + Size * (i + 1) / Threads;
+        if (Load [i].Stop < Load [i].Start)
+          Load [i].Stop = Load [i].Start;
+        while (Load [i].Stop > Text && Load [i].Stop < Text + Size && Load [i].Stop [-1] != '\n')
+          Load [i].Stop++;
+      }
+    ThreadsParallel (TuneLoadSlice, Load, sizeof (_TuneLoad), Threads);
+    // Join the slices into one array
+    TunePositionsN = 0;
+    for (i = 0; i < Threads; i++)
+      TunePositionsN += Load [i].n;
+    TunePositions = (_TunePosition *) malloc ((TunePositionsN + 1) * sizeof (_TunePosition));
+    TunePositionsN = 0;
+    for (i = 0; i < Threads; i++)
+      {
+        if (TunePositions != NULL && Load [i].Res != NULL)
+          MemMove (&TunePositions [TunePositionsN], Load [i].Res, Load [i].n * sizeof (_TunePosition));
+        TunePositionsN += Load [i].n;
+        free (Load [i].Res);
+      }
+    free (Text);
+    return TunePositions != NULL;
+  }
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// TuneError: Mean squared error of sigmoid (score) against the results, over all cores
+//
+
+typedef struct
+  {
+    int From, To;
+    double Weights [7 * 3 + 1];   // Per piece type: value, direct attack, indirect attack. Then move
+    double K;
+    double Error;
+  } _TuneSlice;
+
+void TuneErrorSlice (void *Param)
+  {
+    _TuneSlice *Slice;
+    _TunePosition *tp;
+    const double *w;
+    double Score, Sigmoid, e, Error;
+    int i, p;
+    //
+    Slice = (_TuneSlice *) Param;
+    w = Slice->Weights;
+    Error = 0;
+    for (i = Slice->From; i < Slice->To; i++)
+      {
+        tp = &TunePositions [i];
+        Score = tp->Features.Moves * w [21];
+        for (p = pKing; p <= pPawn; p++)
+          Score += tp->Features.Pieces [p] * w [p] + tp->Features.Direct [p] * w [p + 7] + tp->Features.Indirect [p] * w [p + 14];
+        Sigmoid = 1.0 / (1.0 + exp (-Slice->K * Score));
+        e = tp->Result * 0.5 - Sigmoid;
+        Error += e * e;
+      }
+    Slice->Error = Error;
+  }
+
+longint TuneEvaluations;   // positions evaluated, for speed
+
+double TuneError (int *w, double K, int Threads)
+  {
+    _TuneSlice Slices [256];
+    int PieceValue_ [7];
+    double Error;
+    int i, p;
+    //
+    MemMove (PieceValue_, PieceValue, sizeof (PieceValue_));
+    TuneWeightsSet (w);
+    for (i = 0; i < Threads; i++)
+      {
+        Slices [i].From = (longint) TunePositionsN * i / Threads;
+        Slices [i].To = (longint) TunePositionsN * (i + 1) / Threads;
+        Slices [i].K = K;
+        for (p = pEmpty; p <= pPawn; p++)
+          {
+            Slices [i].Weights [p] = PieceValue [p];
+            Slices [i].Weights [p + 7] = (double) PieceValue [p] * AnalysisScorePiece / 1000 * AnalysisScoreAttack / 1000;
+            Slices [i].Weights [p + 14] = (double) PieceValue [p] * AnalysisScorePiece / 1000 * AnalysisScoreAttackInd / 1000;
+          }
+        Slices [i].Weights [21] = AnalysisScoreMove;
+      }
+    MemMove (PieceValue, PieceValue_, sizeof (PieceValue_));
+    TuneEvaluations += TunePositionsN;
+    ThreadsParallel (TuneErrorSlice, Slices, sizeof (_TuneSlice), Threads);
+    Error = 0;
+    for (i = 0; i < Threads; i++)
+      Error += Slices [i].Error;
+    return Error / Max (TunePositionsN, 1);
+  }
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Tune: Load the positions and fit the weights by coordinate descent
+//
+// K (the sigmoid scale) is fitted first to the current weights. Then each pass moves each weight one
+// step up or down if that lowers the error. Steps halve when no weight moves, until the Move step is 0.
+// Weights are kept above 0 and at most 4 times their starting value.
+// The tuned tables are written to <FileName>.tuned as C, ready to paste into Chess.c
+
+void TuneWrite (const char *FileName, int *w, double Error)
+  {
+    FILE *f;
+    char Name [256];
+    //
+    snprintf (Name, sizeof (Name), "%s.tuned", FileName);
+    f = fopen (Name, "w");
+    if (f == NULL)
+      return;
+    fprintf (f, "// Tuned on %d positions from %s. Error %.6f\n", TunePositionsN, FileName, Error);
+    fprintf (f, "int PieceValue [] = {0,      %d, %d,   %d,  %d,    %d,    %d};\n",
+             PieceValue [pKing], w [twQueen], w [twRook], w [twBishop], w [twKnight], w [twPawn]);
+    fprintf (f, "int AnalysisScoreMove = %d;\n", w [twMove]);
+    fprintf (f, "int AnalysisScoreAttack = %d;   // * Piece Value / 1000\n", w [twAttack]);
+    fprintf (f, "int AnalysisScoreAttackInd = %d;   // \"\n", w [twAttackInd]);
+    fclose (f);
+  }
+
+void Tune (const char *FileName)
+  {
+    int w [twN], Step [twN], Start [twN];
+    double K, KStep, Error, e;
+    int Threads, Time, Pass;
+    bool Better;
+    int i, Dir;
+    //
+    Threads = Min (ThreadCount (), 256);   // the most TuneError and TuneLoad split between
+    Time = ClockMS ();
+    PutString ("Tune: loading ");
+    PutString (FileName);
+    PutNewLine ();
+    if (!TuneLoad (FileName, Threads))
+      {
+        PutStringCRLF ("** Can't read positions");
+        return;
+      }
+    PutInt (TunePositionsN, 0 | IntToLengthCommas);
+    PutString (" Positions. Threads ");
+    PutInt (Threads, 0);
+    PutString (". Time ");
+    PutIntDecimals (ClockMS () - Time, 3);
+    PutNewLine ();
+    if (TunePositionsN == 0)
+      return;
+    TuneWeightsGet (w);
+    TuneWeightsGet (Start);
+    // Fit K
+    K = 1.0 / 4000;
+    KStep = K / 2;
+    Error = TuneError (w, K, Threads);
+    while (KStep > 1.0 / 4000000)
+      {
+        Better = false;
+        for (Dir = -1; Dir <= 1; Dir += 2)
+          if (K + Dir * KStep > 0)
+            {
+              e = TuneError (w, K + Dir * KStep, Threads);
+              if (e < Error)
+                {
+                  Error = e;
+                  K += Dir * KStep;
+                  Better = true;
+                  break;
+                }
+            }
+        if (!Better)
+          KStep /= 2;
+      }
+    // Fit the weights
+    MemMove (Step, TuneWeightStep, sizeof (Step));
+    Time = ClockMS ();
+    TuneEvaluations = 0;
+    Pass = 0;
+    while (Step [twMove] > 0)
+      {
+        Pass++;
+        Better = false;
+        for (i = 0; i < twN; i++)
+          for (Dir = 1; Dir >= -1; Dir -= 2)
+            if (w [i] + Dir * Step [i] > 0 && w [i] + Dir * Step [i] <= 4 * Start [i])
+              {
+                w [i] += Dir * Step [i];
+                e = TuneError (w, K, Threads);
+                if (e < Error)
+                  {
+                    Error = e;
+                    Better = true;
+                    break;
+                  }
+                w [i] -= Dir * Step [i];
+              }
+        PutString ("  Pass ");
+        PutInt (Pass, 0);
+        PutString (" Error ");
+        PutInt ((longint) (Error * 1000000), 0);
+        PutString ("e-6 ");
+        for (i = 0; i < twN; i++)
+          {
+            PutString (" ");
+            PutString (TuneWeightName [i]);
+            PutString (" ");
+            PutInt (w [i], 0);
+          }
+        PutNewLine ();
+        if (!Better)
+          for (i = 0; i < twN; i++)
+            Step [i] /= 2;
+      }
+    Time = ClockMS () - Time;
+    PutString ("Time ");
+    PutIntDecimals (Time, 3);
+    PutString (". Positions/sec ");
+    PutInt (TuneEvaluations * 1000 / Max (Time, 1), 0 | IntToLengthCommas);
+    PutNewLine ();
+    TuneWeightsSet (w);
+    TuneWrite (FileName, w, Error);
+  }
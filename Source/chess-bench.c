@@ -0,0 +1,60 @@
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// CHESS BENCH
+// ===========
+//
+// Author: Stewart Tunbridge, Pi Micros
+// Email:  stewarttunbridge@gmail.com
+// Copyright (c) 2025 Stewart Tunbridge, Pi Micros
+//
+// The engine alone, with no console: search the bench positions to a fixed depth
+//
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// The same search as chess-con Bench, so the moves considered are the same signature. The
+// Makefile trains profile guided builds on it and compares the builds' speed with it.
+//
+// Parameters: chess-bench [<depth>]   (3)
+//
+/////////////////////////////////////////////////////////////////////////////////////
+
+
+const char AppName [] = "Chess Bench";
+const char Revision [] = "1.00";
+
+#include "../Lib/Lib.c"
+#include "Thread.c"
+#include "Trace.c"
+#include "FileMap.c"
+#include "Bitbase.c"
+#include "Tablebase.c"
+#include "Chess.c"
+
+int main (int argc, char *argv [])
+  {
+    int i, Depth, Time, TimeTotal;
+    longint Moves, MovesTotal;
+    //
+    Depth = 3;
+    if (argc > 1)
+      Depth = Min (Max (atoi (argv [1]), 1), DepthMax - 1);
+    BoardInit ();
+    BitbaseInit ();
+    TablebaseInit ();
+    MovesTotal = 0;
+    TimeTotal = 0;
+    for (i = 0; BenchPositions [i]; i++)
+      {
+        Time = ClockMS ();
+        Moves = BenchPosition (BenchPositions [i], Depth);
+        TimeTotal += ClockMS () - Time;
+        if (Moves < 0)
+          {
+            printf ("** Bad FEN %s\n", BenchPositions [i]);
+            return 1;
+          }
+        MovesTotal += Moves;
+      }
+    printf ("Depth %d. Moves %lld. Time %.3f. Moves/sec %lld\n", Depth, MovesTotal, TimeTotal / 1000.0, MovesTotal * 1000 / Max (TimeTotal, 1));
+    return 0;
+  }
@@ -41,12 +41,34 @@ const char Revision [] = "1.01";
   #include "..\Lib\Lib.c"
   #include "..\Lib\Console.c"
   #include "..\Lib\ConsoleLib.c"
+  #include "Thread.c"
+  #include "Trace.c"
+  #include "FileMap.c"
+  #include "Bitbase.c"
+  #include "Tablebase.c"
   #include "Chess.c"
+  #include "Pgn.c"
+  #include "Packed.c"
+  #include "Tune.c"
+  #include "Mate.c"
+  #include <conio.h>
 #else
   #include "../Lib/Lib.c"
   #include "../Lib/Console.c"
   #include "../Lib/ConsoleLib.c"
+  #include "Thread.c"
+  #include "Trace.c"
+  #include "FileMap.c"
+  #include "Bitbase.c"
+  #include "Tablebase.c"
   #include "Chess.c"
+  #include "Pgn.c"
+  #include "Packed.c"
+  #include "Tune.c"
+  #include "Mate.c"
+  #include <poll.h>
+  #include <unistd.h>
+  #include <errno.h>
 #endif
 
 
@@ -84,9 +106,9 @@ bool StrGetCoords (char **St, _Coord *Pos)
       }
   }
 
-char *StWho [] = {"YOU", "I"};
+const char *StWho [] = {"YOU", "I"};
 
-char *PieceSymbol [] = {"  ", "Ki", "Qu", "Ro", "Bi", "Kn", "p"}; //" KQRBKp";
+const char *PieceSymbol [] = {"  ", "Ki", "Qu", "Ro", "Bi", "Kn", "p"}; //" KQRBKp";
 //char PieceSymbol2 [] = " iuoin ";
 
 _Coord Highlight = {-1, -1};
@@ -128,6 +150,8 @@ void ShowHelp ()
     PutStringHighlight ("  |^Z| to undo your last move", ColYellow);
     PutNewLine ();
     PutStringHighlight ("  |^P| Play for me. I'm too dumb to", ColYellow);
+    PutNewLine ();
+    PutStringHighlight ("  |^A| Analyse: show my best moves for you", ColYellow);
   }
 
 _Piece BoardPrev [8][8];   // Board before human movefor backup
@@ -152,60 +176,345 @@ void PutPos (_Coord Pos)
     PutChar (Pos.y + '1');
   }
 
-void ConsoleColours (int FG, int BG)
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// BoardShow: Draw the board as one frame
+//
+// The whole board is built in Frame then written with a single write, with colour escapes only
+// where the colour changes. In place (parameter I) the board is kept at the top of the screen, the
+// text scrolls below it, and only the squares that differ from the last frame are redrawn.
+
+#define FrameRows 10
+#define FrameCols 96
+#define FrameTop 12   // first screen row of the text below an in place board
+
+typedef struct
+  {
+    char Ch;
+    char FG, BG;   // Lib colours
+    bool Italic;
+  } _Cell;
+
+// The Lib colours used, as ConsoleColourFG / BG drew the board
+#define FrameFGWhite (ColWhite | ColBright)
+#define FrameFGBlack ColBlack
+#define FrameFGText ColWhite
+#define FrameBGDark ColGreenDark
+#define FrameBGLight ColBrown
+#define FrameBGText ColBlack
+
+// and the SGR codes the console shows them as, foreground and background
+
+typedef struct
+  {
+    int Colour;
+    const char *FG, *BG;
+  } _FrameColour;
+
+_FrameColour FrameColours [] =
+  {
+    {ColBlack, "30", "40"},
+    {ColWhite, "37", "47"},
+    {ColWhite | ColBright, "97", "107"},
+    {ColGreenDark, "38;5;22", "48;5;22"},
+    {ColBrown, "38;5;94", "48;5;94"},
+  };
+
+_Cell Frame [FrameRows][FrameCols], FramePrev [FrameRows][FrameCols];
+bool FrameInPlace = false;
+bool FramePrevOK = false;
+char FrameBuffer [FrameRows * FrameCols * 24];
+int FrameLength;
+int FrameBytes;   // Size and time (us) of the last frame drawn
+int FrameTime;
+
+longint ClockUS (void)
+  {
+    #ifdef _Windows
+      LARGE_INTEGER Count, Freq;
+      QueryPerformanceCounter (&Count);
+      QueryPerformanceFrequency (&Freq);
+      return Count.QuadPart * 1000000 / Freq.QuadPart;
+    #else
+      struct timespec t;
+      clock_gettime (CLOCK_MONOTONIC, &t);
+      return (longint) t.tv_sec * 1000000 + t.tv_nsec / 1000;
+    #endif
+  }
+
+void FrameAdd (const char *s)
+  {
+    while (*s)
+      FrameBuffer [FrameLength++] = *s++;
+  }
+
+void FrameAddInt (int i)
+  {
+    if (i >= 10)
+      FrameAddInt (i / 10);
+    FrameBuffer [FrameLength++] = '0' + i % 10;
+  }
+
+// Put text in Frame at Row, Col
+
+void FramePut (int Row, int *Col, const char *s, int Length, int FG, int BG, bool Italic)
+  {
+    _Cell *c;
+    //
+    while (Length-- > 0 && *Col < FrameCols)
+      {
+        c = &Frame [Row][(*Col)++];
+        c->Ch = *s ? *s++ : ' ';
+        c->FG = FG;
+        c->BG = BG;
+        c->Italic = Italic;
+      }
+  }
+
+const char *FrameSGR (int Colour, bool BG)
+  {
+    int i;
+    //
+    for (i = 0; i < (int) (sizeof (FrameColours) / sizeof (FrameColours [0])); i++)
+      if (FrameColours [i].Colour == Colour)
+        return BG ? FrameColours [i].BG : FrameColours [i].FG;
+    return BG ? "40" : "37";   // as text
+  }
+
+// Emit a cell, with the escape for any change from the current colours in Cur
+
+void FrameCell (_Cell *c, _Cell *Cur)
   {
-    ConsoleColourFG (FG);
-    ConsoleColourBG (BG);
+    if (c->FG != Cur->FG || c->BG != Cur->BG || c->Italic != Cur->Italic)
+      {
+        FrameAdd ("\x1b[");
+        if (c->Italic != Cur->Italic)
+          {
+            FrameAdd (c->Italic ? "3;" : "23;");
+            Cur->Italic = c->Italic;
+          }
+        if (c->FG != Cur->FG)
+          {
+            FrameAdd (FrameSGR (c->FG, false));
+            FrameAdd (";");
+            Cur->FG = c->FG;
+          }
+        if (c->BG != Cur->BG)
+          {
+            FrameAdd (FrameSGR (c->BG, true));
+            FrameAdd (";");
+            Cur->BG = c->BG;
+          }
+        FrameBuffer [FrameLength - 1] = 'm';   // replace the last ;
+      }
+    FrameBuffer [FrameLength++] = c->Ch;
+  }
+
+// Past stdio, which on a terminal would split it at each line or 1KB
+
+void FrameWrite (void)
+  {
+    fflush (stdout);   // anything already written goes first
+    #ifdef _Windows
+      fwrite (FrameBuffer, 1, FrameLength, stdout);
+      fflush (stdout);
+    #else
+      const char *s;
+      int n, Length;
+      //
+      s = FrameBuffer;
+      Length = FrameLength;
+      while (Length > 0)
+        {
+          n = write (STDOUT_FILENO, s, Length);
+          if (n < 0 && errno == EINTR)
+            continue;
+          if (n <= 0)
+            break;
+          s += n;
+          Length -= n;
+        }
+    #endif
+  }
+
+// Call before the console closes, to give back the whole screen
+
+void FrameDone (void)
+  {
+    if (FrameInPlace && FramePrevOK)
+      {
+        fflush (stdout);
+        fputs ("\x1b[r", stdout);
+        fflush (stdout);
+      }
   }
 
 void BoardShow (void)
   {
-    int x, y;
-    int c;
+    int x, y, Row, Col;
+    int FG, BG;
+    _Cell Cur, *c;
+    bool Move;
+    longint Time;
     //
+    Time = ClockUS ();
+    // Build the frame
+    for (Row = 0; Row < FrameRows; Row++)
+      {
+        Col = 0;
+        FramePut (Row, &Col, "", FrameCols, FrameFGText, FrameBGText, false);
+      }
     for (y = 8; y >= -1; y--)
       {
-        PutNewLine ();
-        PutString ("  ");
+        Row = 8 - y;
+        Col = 2;
         if ((y == 8) || (y == -1))
           {
-            PutString ("  ");
+            Col += 2;
             for (x = 0; x < 8; x++)
               {
-                PutChar (' ');
-                PutChar ('a' + x);
-                PutChar (' ');
+                Frame [Row][Col + 1].Ch = 'a' + x;
+                Col += 3;
               }
           }
         else
           {
-            PutChar ('1' + y);
-            PutChar (' ');
+            Frame [Row][Col].Ch = '1' + y;
+            Col += 2;
             for (x = 0; x < 8; x++)
               {
                 if ((x ^ y) & 0x01)
-                  ConsoleColourBG (ColGreenDark); //(ColBlack | ColBright);
+                  BG = FrameBGDark;
                 else
-                  ConsoleColourBG (ColBrown); //(ColCyanDark);
+                  BG = FrameBGLight;
                 if (PieceWhite (Board [x][y]))
-                  c = ColWhite | ColBright;
+                  FG = FrameFGWhite;
                 else
-                  c = ColBlack;
-                if ((x == Highlight.x) && (y == Highlight.y))
-                  c = c | ColItalic;
-                ConsoleColourFG (c);
-                PutChar (' ');
-                PutStringN (PieceSymbol [Piece (Board [x][y])], 2);
+                  FG = FrameFGBlack;
+                FramePut (Row, &Col, " ", 1, FG, BG, false);
+                FramePut (Row, &Col, PieceSymbol [Piece (Board [x][y])], 2, FG, BG, (x == Highlight.x) && (y == Highlight.y));
               }
-            ConsoleColours (ColWhite, ColBlack);
-            PutChar (' ');
-            PutChar ('1' + y);
+            Frame [Row][Col + 1].Ch = '1' + y;
+            Col += 2;
             if (y == 7)
-              PutString (Bodies [true]);
+              FramePut (Row, &Col, Bodies [true], StrLength (Bodies [true]), FrameFGText, FrameBGText, false);
             if (y == 0)
-              PutString (Bodies [false]);
+              FramePut (Row, &Col, Bodies [false], StrLength (Bodies [false]), FrameFGText, FrameBGText, false);
           }
       }
+    // Turn it into text
+    FrameLength = 0;
+    Cur.FG = FrameFGText;
+    Cur.BG = FrameBGText;
+    Cur.Italic = false;
+    FrameAdd ("\x1b[0;37;40m");
+    if (!FrameInPlace)   // Whole board, where the cursor is
+      for (Row = 0; Row < FrameRows; Row++)
+        {
+          FrameAdd ("\r\n");
+          for (Col = FrameCols; Col > 0 && Frame [Row][Col - 1].Ch == ' ' && Frame [Row][Col - 1].BG == FrameBGText; Col--)
+            ;   // trim trailing space
+          for (x = 0; x < Col; x++)
+            FrameCell (&Frame [Row][x], &Cur);
+        }
+    else   // At the top of the screen, only what changed
+      {
+        if (!FramePrevOK)   // First frame: clear the screen and keep the text scrolling below the board
+          {
+            FrameAdd ("\x1b[2J\x1b[");
+            FrameAddInt (FrameTop);
+            FrameAdd ("r\x1b[");
+            FrameAddInt (FrameTop);
+            FrameAdd (";1H");
+          }
+        FrameAdd ("\0337");   // save cursor
+        for (Row = 0; Row < FrameRows; Row++)
+          {
+            Move = true;
+            for (Col = 0; Col < FrameCols; Col++)
+              {
+                c = &Frame [Row][Col];
+                if (FramePrevOK && c->Ch == FramePrev [Row][Col].Ch && c->FG == FramePrev [Row][Col].FG &&
+                    c->BG == FramePrev [Row][Col].BG && c->Italic == FramePrev [Row][Col].Italic)
+                  Move = true;   // unchanged, skip it
+                else
+                  {
+                    if (Move)
+                      {
+                        FrameAdd ("\x1b[");
+                        FrameAddInt (Row + 1);
+                        FrameAdd (";");
+                        FrameAddInt (Col + 1);
+                        FrameAdd ("H");
+                        Move = false;
+                      }
+                    FrameCell (c, &Cur);
+                  }
+              }
+          }
+        FrameAdd ("\0338");   // restore cursor and colours
+        Cur.FG = FrameFGText;
+        Cur.BG = FrameBGText;
+        Cur.Italic = false;
+        MemMove (FramePrev, Frame, sizeof (Frame));
+        FramePrevOK = true;
+      }
+    if (Cur.FG != FrameFGText || Cur.BG != FrameBGText || Cur.Italic)
+      FrameAdd ("\x1b[0;37;40m");
+    FrameWrite ();
+    FrameBytes = FrameLength;
+    FrameTime = ClockUS () - Time;
+  }
+
+// Show a score, or the moves to mate
+
+void PutScore (int Score)
+  {
+    if (ScoreMate (Score))
+      {
+        PutString (Score > 0 ? "Mate in " : "Mated in ");
+        PutInt (ScoreMateMoves (Score), 0);
+      }
+    else
+      PutInt (Score, 0 | IntToLengthCommas);
+  }
+
+// Show the best MultiPV moves with their scores and lines
+
+int MultiPV = 3;
+
+void ShowBestMoves (bool PlayWhite)
+  {
+    _RootMove Moves [MovesMax];
+    int n, i, j;
+    //
+    MovesConsidered = 0;
+    InCheck (PlayWhite);   // update Checked status on King piece
+    n = BestMoves (PlayWhite, MultiPV, Moves);
+    for (i = 0; i < n; i++)
+      {
+        PutNewLine ();
+        PutString ("  ");
+        PutInt (i + 1, 2);
+        PutString (". ");
+        PutPos (Moves [i].Move.From);
+        PutPos (Moves [i].Move.To);
+        PutString ("  Score ");
+        PutScore (Moves [i].Score);
+        PutString (" ");
+        for (j = 0; j < Moves [i].LineLength; j++)
+          {
+            PutChar (' ');
+            PutPos (Moves [i].Line [j].From);
+            PutPos (Moves [i].Line [j].To);
+          }
+      }
+    if (n == 0)
+      PutString (" ** NO MOVES");
+    PutNewLine ();
+    PutString ("  ");
+    PutInt (MovesConsidered, 0 | IntToLengthCommas);
+    PutString (" Moves");
   }
 
 _SpecialMove MovePiece_ (_Coord From, _Coord To)
@@ -260,14 +569,11 @@ bool GetMove (void)
                       BodiesLen [false] = StrLength (Bodies [false]);
                       BodiesLen [true] = StrLength (Bodies [true]);
                       p = Board [b.x][b.y];
-                      MovePiece_ (a, b);
-                      if (InCheck (PlayerWhite))
-                        {
-                          MemMove (Board, BoardPrev, sizeof (Board));
-                          PutString (" ** Save the King");
-                        }
+                      if (!MoveLegal (a, b) && !Cheat)   // in, into or through check
+                        PutString (" ** Save the King");
                       else
                         {
+                          MovePiece_ (a, b);
                           OK = true;
                           ShowPieceTaken (p);
                         }
@@ -278,7 +584,8 @@ bool GetMove (void)
         else if (ch == Cntrl ('P'))
           {
             PutString ("Play ");
-            if (BestMove (PlayerWhite, 0) == MININT)   // no moves possible
+            BestMove (PlayerWhite, 0);
+            if (RootMovesN == 0)   // no moves possible
               PutString (" ** NO MOVES. Give up");
             else
               {
@@ -295,6 +602,11 @@ bool GetMove (void)
                 OK = true;
               }
           }
+        else if (ch == Cntrl ('A'))
+          {
+            PutString ("Analyse");
+            ShowBestMoves (PlayerWhite);
+          }
         else if (ch == Cntrl ('Z') && BoardPrevOK)
           {
             PutString ("Undo");
@@ -316,6 +628,465 @@ bool GetMove (void)
   }
 
 
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// CPUThink: The CPU's search, with progress shown while it runs. Any key stops it
+//
+// The search calls CPUPoll every 1024 moves. That looks at the clock and the keyboard, and shows
+// progress no more than every ProgressMS.
+
+#define ProgressMS 250
+
+int ProgressTime, ProgressStart;
+bool CPUStopped;
+
+// True if a key has been pressed. The key is used up
+
+bool KeyPressed (void)
+  {
+    #ifdef _Windows
+      if (!_kbhit ())
+        return false;
+      _getch ();
+      return true;
+    #else
+      struct pollfd In;
+      char c;
+      //
+      In.fd = 0;
+      In.events = POLLIN;
+      if (poll (&In, 1, 0) <= 0)
+        return false;
+      return read (0, &c, 1) > 0;   // 0 at the end of input, which isn't a key
+    #endif
+  }
+
+void CPUPoll (void)
+  {
+    int t;
+    //
+    t = ClockMS ();
+    if (t - ProgressTime < ProgressMS)
+      return;
+    ProgressTime = t;
+    if (KeyPressed ())
+      {
+        SearchStop = true;
+        CPUStopped = true;
+      }
+    PutString ("\r  Depth ");
+    PutInt (SearchDepth, 0);
+    PutString ("  ");
+    PutInt (MovesConsidered, 0 | IntToLengthCommas);
+    PutString (" Moves  ");
+    PutInt (MovesConsidered * 1000 / Max (t - ProgressStart, 1), 0 | IntToLengthCommas);
+    PutString ("/sec  Best ");
+    PutPos (BestA [0]);
+    PutPos (BestB [0]);
+    PutString ("  (any key stops)   ");
+  }
+
+int CPUThink (bool PlayWhite)
+  {
+    int Score;
+    //
+    ProgressStart = ClockMS ();
+    ProgressTime = ProgressStart;
+    CPUStopped = false;
+    SearchPoll = CPUPoll;
+    Score = BestMoveIterative (PlayWhite, DepthPlay);
+    SearchPoll = NULL;
+    PutString ("\r                                                                              \r");
+    return Score;
+  }
+
+// Trace: Record every search to a file, for chess-trace. Needs a build with -DTRACE
+
+bool TraceBegin (const char *FileName)
+  {
+    #ifdef TRACE
+      if (TraceStart (FileName))
+        return true;
+      PutStringCRLF ("** Can't write trace file");
+    #else
+      PutStringCRLF ("** Trace needs a build with -DTRACE");
+    #endif
+    return false;
+  }
+
+void TraceEnd (void)
+  {
+    TraceStop ();
+    PutString ("Trace ");
+    PutInt (TraceRecords, 0 | IntToLengthCommas);
+    PutString (" Records. ");
+    PutInt (TraceDropped, 0 | IntToLengthCommas);
+    PutString (" Dropped");
+    PutNewLine ();
+  }
+
+// Bench: Search the built in positions. Total moves considered is the signature of the build
+//
+
+void Bench (int Depth)
+  {
+    int i;
+    longint Moves, MovesTotal;
+    int Time, TimeTotal;
+    //
+    PutString ("Bench Depth ");
+    PutInt (Depth, 0);
+    PutNewLine ();
+    MovesTotal = 0;
+    TimeTotal = 0;
+    for (i = 0; BenchPositions [i]; i++)
+      {
+        Time = ClockMS ();
+        Moves = BenchPosition (BenchPositions [i], Depth);
+        Time = ClockMS () - Time;
+        PutString ("  ");
+        PutInt (i + 1, 2);
+        PutString (": ");
+        if (Moves < 0)
+          {
+            PutString ("** Bad FEN ");
+            PutStringCRLF (BenchPositions [i]);
+            continue;
+          }
+        PutInt (Moves, 12 | IntToLengthCommas);
+        PutString (" Moves. Time ");
+        PutIntDecimals (Time, 3);
+        PutNewLine ();
+        MovesTotal += Moves;
+        TimeTotal += Time;
+      }
+    PutString ("Moves ");
+    PutInt (MovesTotal, 0 | IntToLengthCommas);
+    PutString (". Time ");
+    PutIntDecimals (TimeTotal, 3);
+    PutString (". Moves/sec ");
+    PutInt (MovesTotal * 1000 / Max (TimeTotal, 1), 0 | IntToLengthCommas);
+    PutNewLine ();
+  }
+
+// Pgn: Replay all the games in a PGN file, report how many & speed
+
+void PgnNoPosition (void *User, bool PlayWhite, _Coord From, _Coord To, int Result)
+  {
+  }
+
+void PgnNoGameEnd (void *User, int Result, int Moves, bool Error)
+  {
+  }
+
+void Pgn (const char *FileName)
+  {
+    const _PgnSink Sink = {PgnNoPosition, PgnNoGameEnd};
+    char Users [256];
+    _PgnSlice Total;
+    int Threads, Time;
+    //
+    Threads = ThreadCount ();
+    Time = ClockMS ();
+    if (!PgnRead (FileName, &Sink, Users, 1, Threads, &Total))
+      {
+        PutStringCRLF ("** Can't read PGN file");
+        return;
+      }
+    Time = ClockMS () - Time;
+    PutInt (Total.Games, 0 | IntToLengthCommas);
+    PutString (" Games. ");
+    PutInt (Total.Moves, 0 | IntToLengthCommas);
+    PutString (" Moves. ");
+    PutInt (Total.Errors, 0 | IntToLengthCommas);
+    PutString (" Errors. Threads ");
+    PutInt (Threads, 0);
+    PutString (". Time ");
+    PutIntDecimals (Time, 3);
+    PutString (". Moves/sec ");
+    PutInt (Total.Moves * 1000 / Max (Time, 1), 0 | IntToLengthCommas);
+    PutNewLine ();
+  }
+
+// Pack: Write every position in a FEN or PGN file to <file>.cpk, with its result where known. FEN
+// lines are as Tune reads them. Then read it back, to check it and time it
+
+typedef struct
+  {
+    _Packed *Res;
+    longint n, Size;
+    int Plies, HalfMoves;   // in the game so far
+  } _Pack;
+
+void PackAdd (_Pack *Pack, const _Packed *p)
+  {
+    _Packed *Res;
+    //
+    if (Pack->n >= Pack->Size)
+      {
+        Res = (_Packed *) realloc (Pack->Res, (Pack->Size * 2 + 4096) * sizeof (_Packed));
+        if (Res == NULL)
+          return;
+        Pack->Res = Res;
+        Pack->Size = Pack->Size * 2 + 4096;
+      }
+    Pack->Res [Pack->n++] = *p;
+  }
+
+void PackPgnPosition (void *User, bool PlayWhite, _Coord From, _Coord To, int Result)
+  {
+    _Pack *Pack;
+    _Packed p;
+    //
+    Pack = (_Pack *) User;
+    if (PackBoard (PlayWhite, &p))
+      {
+        p.HalfMoves = Min (Pack->HalfMoves, 255);
+        p.FullMoves = 1 + Pack->Plies / 2;
+        p.Result = Result;
+        PackAdd (Pack, &p);
+      }
+    // The clocks after this move
+    Pack->Plies++;
+    if (Piece (Board [From.x][From.y]) == pPawn || Piece (Board [To.x][To.y]) != pEmpty)
+      Pack->HalfMoves = 0;
+    else
+      Pack->HalfMoves++;
+  }
+
+void PackPgnGameEnd (void *User, int Result, int Moves, bool Error)
+  {
+    ((_Pack *) User)->Plies = 0;
+    ((_Pack *) User)->HalfMoves = 0;
+  }
+
+// Read back: unpacked on the Board, each must pack the same again
+
+void PackCheck (void *User, const _Packed *p, longint Index, bool PlayWhite)
+  {
+    _Packed Again;
+    //
+    if (!PackBoard (PlayWhite, &Again))
+      {
+        (*(longint *) User)++;
+        return;
+      }
+    Again.HalfMoves = p->HalfMoves;
+    Again.Result = p->Result;
+    Again.FullMoves = p->FullMoves;
+    Again.Score = p->Score;
+    if (memcmp (&Again, p, sizeof (_Packed)) != 0)
+      (*(longint *) User)++;
+  }
+
+void Pack (const char *FileName)
+  {
+    const _PgnSink Sink = {PackPgnPosition, PackPgnGameEnd};
+    _Pack Packs [256];
+    _PackedWriter w;
+    _PackedFile f;
+    _PgnSlice Total;
+    _Packed p;
+    longint Errors [256], n;
+    char Line [256], OutName [1024], *s;
+    int Threads, Time, i, Half, Full;
+    bool PlayWhite, OK;
+    FILE *In;
+    //
+    Threads = Min (ThreadCount (), 256);
+    for (i = 0; i < Threads; i++)
+      {
+        Packs [i].Res = NULL;
+        Packs [i].n = Packs [i].Size = 0;
+        Packs [i].Plies = Packs [i].HalfMoves = 0;
+      }
+    Time = ClockMS ();
+    i = StrLength (FileName);
+    if (i > 4 && (FileName [i - 4] == '.') && (UpCase (FileName [i - 3]) == 'P') && (UpCase (FileName [i - 2]) == 'G') && (UpCase (FileName [i - 1]) == 'N'))
+      OK = PgnRead (FileName, &Sink, Packs, sizeof (_Pack), Threads, &Total);
+    else
+      {
+        Threads = 1;
+        In = fopen (FileName, "r");
+        OK = (In != NULL);
+        if (OK)
+          {
+            while (fgets (Line, sizeof (Line), In))
+              {
+                Line [strcspn (Line, "\r\n")] = 0;
+                if (!BoardFromFEN (Line, &PlayWhite) || !PackBoard (PlayWhite, &p))
+                  continue;
+                // After the 4 FEN fields, the clocks if there, and the result
+                for (s = Line, i = 0; *s && i < 4; s++)
+                  if (*s == ' ')
+                    i++;
+                if (sscanf (s, "%d %d", &Half, &Full) == 2)
+                  {
+                    p.HalfMoves = Min (Max (Half, 0), 255);
+                    p.FullMoves = Min (Max (Full, 1), 65535);
+                  }
+                p.Result = TuneResult (s, s + StrLength (s));
+                PackAdd (&Packs [0], &p);
+              }
+            fclose (In);
+          }
+      }
+    snprintf (OutName, sizeof (OutName), "%s.cpk", FileName);
+    if (OK)
+      OK = PackedCreate (OutName, &w);
+    for (i = 0; i < Threads; i++)
+      {
+        if (OK && Packs [i].n > 0)
+          OK = PackedWrite (&w, Packs [i].Res, Packs [i].n);
+        free (Packs [i].Res);
+      }
+    if (OK)
+      OK = PackedClose (&w);
+    if (!OK)
+      {
+        PutStringCRLF ("** Can't pack the positions");
+        return;
+      }
+    Time = ClockMS () - Time;
+    PutInt (w.Count, 0 | IntToLengthCommas);
+    PutString (" Positions packed to ");
+    PutString (OutName);
+    PutString (". Time ");
+    PutIntDecimals (Time, 3);
+    PutNewLine ();
+    // Read back
+    if (!PackedOpen (OutName, &f))
+      {
+        PutStringCRLF ("** Can't read it back");
+        return;
+      }
+    Threads = Min (ThreadCount (), 256);
+    for (i = 0; i < Threads; i++)
+      Errors [i] = 0;
+    Time = ClockMS ();
+    n = PackedForEach (f.Records, f.Count, PackCheck, Errors, sizeof (longint), Threads);   // those that won't unpack
+    Time = ClockMS () - Time;
+    for (i = 0; i < Threads; i++)
+      n += Errors [i];
+    PutString ("Read back & unpacked in ");
+    PutIntDecimals (Time, 3);
+    PutString (". Positions/sec ");
+    PutInt (f.Count * 1000 / Max (Time, 1), 0 | IntToLengthCommas);
+    PutString (". MB/sec ");
+    PutInt (f.Count * (longint) sizeof (_Packed) / 1000 / Max (Time, 1), 0 | IntToLengthCommas);
+    PutString (". Errors ");
+    PutInt (n, 0 | IntToLengthCommas);
+    PutNewLine ();
+    PackedCloseFile (&f);
+  }
+
+// Analyse: Show the best moves for every FEN in a file, one per line
+
+void Analyse (const char *FileName)
+  {
+    FILE *f;
+    char Line [256];
+    bool PlayWhite;
+    //
+    f = fopen (FileName, "r");
+    if (f == NULL)
+      {
+        PutStringCRLF ("** Can't read FEN file");
+        return;
+      }
+    while (fgets (Line, sizeof (Line), f))
+      {
+        Line [strcspn (Line, "\r\n")] = 0;
+        if (!BoardFromFEN (Line, &PlayWhite))
+          continue;
+        PutNewLine ();
+        PutString (Line);
+        ShowBestMoves (PlayWhite);
+        PutNewLine ();
+      }
+    fclose (f);
+  }
+
+// Mate: Solve for the quickest mate in up to MaxMoves for every FEN in a file
+
+#define MateNodes 2500000   // 2.5M nodes of 36 bytes is 90MB
+
+void Mate (const char *FileName, int MaxMoves)
+  {
+    FILE *f;
+    char Line [256];
+    bool PlayWhite;
+    _Move MateLine [128];
+    int Moves, Length, i, Time;
+    longint Nodes;
+    int Solved, Total;
+    //
+    f = fopen (FileName, "r");
+    if (f == NULL)
+      {
+        PutStringCRLF ("** Can't read FEN file");
+        return;
+      }
+    Solved = 0;
+    Total = 0;
+    while (fgets (Line, sizeof (Line), f))
+      {
+        Line [strcspn (Line, "\r\n")] = 0;
+        if (!BoardFromFEN (Line, &PlayWhite))
+          continue;
+        InCheck (PlayWhite);   // update Checked status on King piece
+        Time = ClockMS ();
+        Moves = MateSolve (PlayWhite, MaxMoves, MateNodes, MateLine, &Length, &Nodes);
+        Time = ClockMS () - Time;
+        Total++;
+        PutString (Line);
+        PutNewLine ();
+        PutString ("  ");
+        if (Moves > 0)
+          {
+            Solved++;
+            PutString ("Mate in ");
+            PutInt (Moves, 0);
+            PutString (": ");
+            for (i = 0; i < Length; i++)
+              {
+                PutPos (MateLine [i].From);
+                PutPos (MateLine [i].To);
+                PutChar (' ');
+              }
+          }
+        else if (Moves == 0)
+          {
+            PutString ("No mate in ");
+            PutInt (MaxMoves, 0);
+          }
+        else
+          PutString ("** Out of memory");
+        PutString ("  ");
+        PutInt (Nodes, 0 | IntToLengthCommas);
+        PutString (" Nodes. Time ");
+        PutIntDecimals (Time, 3);
+        PutNewLine ();
+      }
+    fclose (f);
+    PutInt (Solved, 0);
+    PutString (" of ");
+    PutInt (Total, 0);
+    PutString (" Mates found");
+    PutNewLine ();
+  }
+
+// Case insensitive test for a word parameter
+
+bool ParamIs (char *Param, const char *Name)
+  {
+    while (*Name)
+      if (UpCase (*Param++) != UpCase (*Name++))
+        return false;
+    return *Param == 0;
+  }
+
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 // main ()
@@ -327,6 +1098,17 @@ bool GetMove (void)
 //   C   Cheat: don't check human's moves
 //   0-9 Set Depth
 //   S   Simple analysis mode
+//   I   Board stays in place at the top of the screen
+//   Bench  Search the bench positions at the set depth, report moves considered & speed, then exit
+//   Tune <file>  Tune the evaluation weights to the positions & results in <file>, then exit
+//   Pgn <file>   Replay all the games in a PGN file, report errors & speed, then exit
+//   Analyse <file>  Show the best moves, scores & lines for each FEN in <file>, then exit
+//   PV <n>       How many best moves Analyse and ^A show (3)
+//   Mate <file>  Find the quickest mate, in up to Depth moves, for each FEN in <file>, then exit
+//   Trace <file> Record every search to <file>, for chess-trace. Needs a build with -DTRACE
+//   Tb <dir>     Use the tablebases in <dir>, made by chess-tbgen
+//   Pack <file>  Pack every position in a FEN or PGN file to <file>.cpk (32 bytes each), then exit.
+//                Tune reads .cpk files
 
 int main (int argc, char *argv [])
   {
@@ -336,6 +1118,10 @@ int main (int argc, char *argv [])
     _Piece p;
     int Score;
     int Time;
+    bool BenchRun, Trace;
+    _Move Moves [MovesMax];
+    int Checkers;
+    char *TuneFile, *PgnFile, *AnalyseFile, *MateFile, *PackFile;
     //
     ConsoleInit (false);
     ConsoleClear (ColWhite, ColBlack);
@@ -348,9 +1134,49 @@ int main (int argc, char *argv [])
     DepthPlay = 2;
     MoveCount = 1;
     GameOver = false;
+    BenchRun = false;
+    Trace = false;
+    TuneFile = NULL;
+    PgnFile = NULL;
+    AnalyseFile = NULL;
+    MateFile = NULL;
+    PackFile = NULL;
     BoardInit ();
+    if (BitbaseInit ())
+      {
+        PutString ("Bitbases KPK KRK KQK built in ");
+        PutInt (BitbaseTime, 0);
+        PutStringCRLF ("ms");
+      }
+    TablebaseInit ();
     for (i = 1; i < argc; i++)
-      if (UpCase (*argv [i]) == 'W')
+      if (ParamIs (argv [i], "Bench"))
+        BenchRun = true;
+      else if (ParamIs (argv [i], "Tune") && i + 1 < argc)
+        TuneFile = argv [++i];
+      else if (ParamIs (argv [i], "Pgn") && i + 1 < argc)
+        PgnFile = argv [++i];
+      else if (ParamIs (argv [i], "Analyse") && i + 1 < argc)
+        AnalyseFile = argv [++i];
+      else if (ParamIs (argv [i], "Mate") && i + 1 < argc)
+        MateFile = argv [++i];
+      else if (ParamIs (argv [i], "Trace") && i + 1 < argc)
+        Trace = TraceBegin (argv [++i]);
+      else if (ParamIs (argv [i], "Pack") && i + 1 < argc)
+        PackFile = argv [++i];
+      else if (ParamIs (argv [i], "Tb") && i + 1 < argc)
+        {
+          PutString ("Tablebases: ");
+          PutInt (TablebaseOpen (argv [++i]), 0);
+          PutStringCRLF (" found");
+        }
+      else if (ParamIs (argv [i], "PV") && i + 1 < argc)
+        {
+          MultiPV = atoi (argv [++i]);
+          if (MultiPV < 1)
+            MultiPV = 1;
+        }
+      else if (UpCase (*argv [i]) == 'W')
         PlayerWhite = true;
       else if (UpCase (*argv [i]) == 'B')
         PlayerWhite = false;
@@ -360,8 +1186,29 @@ int main (int argc, char *argv [])
         Cheat = true;
       else if (UpCase (*argv [i]) == 'S')
         SimpleAnalysis = true;
+      else if (UpCase (*argv [i]) == 'I')
+        FrameInPlace = true;
       else
-        PutStringCRLF ("Invalid Parameter. Valid parameters: W B C 0-9 S");
+        PutStringCRLF ("Invalid Parameter. Valid parameters: W B C 0-9 S I Bench Tune Pgn Analyse PV Mate Trace Tb Pack");
+    if (BenchRun || TuneFile || PgnFile || AnalyseFile || MateFile || PackFile)
+      {
+        if (MateFile)
+          Mate (MateFile, DepthPlay);
+        if (AnalyseFile)
+          Analyse (AnalyseFile);
+        if (PgnFile)
+          Pgn (PgnFile);
+        if (PackFile)
+          Pack (PackFile);
+        if (TuneFile)
+          Tune (TuneFile);
+        if (BenchRun)
+          Bench (DepthPlay);
+        if (Trace)
+          TraceEnd ();
+        ConsoleUninit (false);
+        return 0;
+      }
     PutString ("Depth ");
     PutInt (DepthPlay, 0);
     if (SimpleAnalysis)
@@ -375,6 +1222,16 @@ int main (int argc, char *argv [])
             if (Show)
               BoardShow ();
             Show = false;
+            if (GetLegalMoves (PlayerWhite, Moves, &Checkers) == 0)
+              {
+                PutNewLine ();
+                if (Checkers > 0)
+                  PutString ("CHECKMATE  **I WON");
+                else
+                  PutString ("STALEMATE");
+                GameOver = true;
+                break;
+              }
             if (GetMove ())
               MoveCount++;
           }
@@ -384,8 +1241,13 @@ int main (int argc, char *argv [])
             MovesConsidered = 0;
             Time = ClockMS ();
             InCheck (!PlayerWhite);   // update Checked status on King piece
-            Score = BestMove (!PlayerWhite, 0);
-            if (Score == MININT)
+            Score = CPUThink (!PlayerWhite);
+            if (RootMovesN == 0 && Score == 0)
+              {
+                PutStringCRLF ("STALEMATE");
+                GameOver = true;
+              }
+            else if (RootMovesN == 0 || (ScoreMate (Score) && Score < 0))   // mated, or will be
               {
                 PutStringCRLF ("I SURRENDER");
                 GameOver = true;
@@ -395,35 +1257,36 @@ int main (int argc, char *argv [])
                 a = BestA [0];
                 b = BestB [0];
                 Highlight = b;
-                if (Piece (Board [b.x][b.y]) == pKing)   // I just took your King
-                  {
-                    PutString ("** By the way, you are in CHECK. Try again");
-                    Undo ();
-                    MoveCount--;
-                  }
-                else
-                  {
-                    p = Board [b.x][b.y];
-                    PutChar ('[');
-                    PutInt (MoveCount, 0);
-                    PutString ("] ");
-                    PutPos (a);
-                    PutPos (b);
-                    ShowPieceTaken (p);
-                    MovePiece_ (a, b);
-                    PutString ("  ");
-                    PutInt (MovesConsidered, 0 | IntToLengthCommas);
-                    PutString (" Moves. Score ");
-                    PutInt (Score, 0 | IntToLengthCommas);
-                    PutString (". Time ");
-                    PutIntDecimals (ClockMS () - Time, 3);
-                    MoveCount++;
-                    Show = true;
-                  }
+                p = Board [b.x][b.y];
+                PutChar ('[');
+                PutInt (MoveCount, 0);
+                PutString ("] ");
+                PutPos (a);
+                PutPos (b);
+                ShowPieceTaken (p);
+                MovePiece_ (a, b);
+                PutString ("  ");
+                PutInt (MovesConsidered, 0 | IntToLengthCommas);
+                PutString (" Moves. Score ");
+                PutScore (Score);
+                PutString (CPUStopped ? ". Stopped at Depth " : ". Depth ");
+                PutInt (SearchDepth, 0);
+                PutString (". Time ");
+                PutIntDecimals (ClockMS () - Time, 3);
+                PutString (". Previous frame ");
+                PutInt (FrameBytes, 0 | IntToLengthCommas);
+                PutString (" bytes ");
+                PutInt (FrameTime, 0 | IntToLengthCommas);
+                PutString ("us");
+                MoveCount++;
+                Show = true;
               }
           }
       }
     PutNewLine ();
+    if (Trace)
+      TraceEnd ();
+    FrameDone ();
     ConsoleUninit (false);
   }
 
@@ -0,0 +1,671 @@
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// CHESS SERVER
+// ============
+//
+// Author: Stewart Tunbridge, Pi Micros
+// Email:  stewarttunbridge@gmail.com
+// Copyright (c) 2025 Stewart Tunbridge, Pi Micros
+//
+// Many games in one process, for Linux
+//
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// Clients connect to a Unix socket and send lines. Replies are lines too. A client may have any
+// number of games going. The engine's searches all run on one fixed pool of worker threads.
+//
+// A search is iterative deepening, one depth at a time. After each depth the game goes to the back
+// of the queue, so a deep search can't hold a worker while other games wait. A game stops
+// deepening at its depth, or when the next depth would take it over its time per move.
+//
+// The engine's tables (piece moves, piece values) are read only and shared by every game. Each
+// worker searches on its own thread_local Board, loaded from the game.
+//
+// Replies are queued on the client while ServerLock is held, so they keep their order, and sent
+// once it's released. A client that stops reading for ClientTimeout seconds is dropped, so it
+// only ever holds up the thread sending to it.
+//
+// Commands                       Replies
+//   new <w|b> [depth] [ms]       game <id>                   human plays w or b. Default 8, 1000ms
+//   fen <id> <FEN>               ok                          set up the position
+//   move <id> <e2e4>             ok, then move <id> ...      the human's move, then the engine's
+//   go <id>                      move <id> <e7e5> score <n> depth <n> ms <n>   engine plays the side
+//                                                            to move, the human takes the other
+//   end <id>                     ok
+//   stats                        stats ..., game ... lines, ok
+//   (any error)                  error <reason>
+// When a game is over "over <id> checkmate" or "over <id> stalemate" follows.
+//
+// Parameters: chess-server [<socket path>] [Threads <n>] [Tb <tablebase dir>]
+//
+/////////////////////////////////////////////////////////////////////////////////////
+
+
+const char AppName [] = "Chess Server";
+const char Revision [] = "1.01";
+
+#include "../Lib/Lib.c"
+#include "Thread.c"
+#include "Trace.c"
+#include "FileMap.c"
+#include "Bitbase.c"
+#include "Tablebase.c"
+#include "Chess.c"
+
+#include <stdio.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#define GamesMax 1024
+#define ClientsMax 64
+#define LineMax 256
+#define OutMax 0x10000   // replies waiting to be sent, per client
+#define ClientTimeout 2   // seconds a send may wait
+#define LatencyN 256   // latencies kept per game, and for all games
+
+typedef enum {gsFree, gsIdle, gsQueued, gsSearching} _GameState;
+
+typedef struct
+  {
+    int Samples [LatencyN];   // ms, a ring
+    int N;   // samples ever
+  } _Latency;
+
+typedef struct
+  {
+    _GameState State;
+    int ID;
+    int Client;
+    bool Ended;   // ended while queued or searching. Freed by the worker
+    _Board Board;
+    int MoveID;
+    bool HumanWhite;
+    bool WhiteToMove;
+    int Depth, Budget;   // search depth limit, ms per move
+    // The search in progress
+    int Iteration;   // depth done
+    int Start;   // ClockMS when asked to move
+    int LastTime;   // ms for the last depth
+    _Move Best;
+    int Score;
+    int Moves;
+    _Latency Latency;
+  } _Game;
+
+typedef struct
+  {
+    int Socket;   // -1 => closed
+    _Lock Send;   // held while writing, and while closing
+    _Lock Queue;   // guards Out. Never held while writing
+    char Out [OutMax];
+    int OutN;
+    char In [LineMax];
+    int InN;
+  } _Client;
+
+_Game Games [GamesMax];
+_Client Clients [ClientsMax];
+int GameNextID = 1;
+
+// ServerLock guards Games and the Queue. Lock it before any Client Queue lock, and never hold it
+// while sending
+
+_Lock ServerLock;
+_Signal ServerWork;
+int Queue [GamesMax];   // game indexes, a ring
+int QueueHead, QueueN;
+int Searching;
+_Latency LatencyAll;
+int Workers;
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Replies
+//
+
+// Queue a reply. If the client is so far behind there's no room it's cut off: the main loop
+// will see it close
+
+void ClientSend (int c, const char *Line)
+  {
+    int Length;
+    //
+    Lock (&Clients [c].Queue);
+    Length = StrLength (Line);
+    if (Clients [c].OutN + Length <= OutMax)
+      {
+        memcpy (Clients [c].Out + Clients [c].OutN, Line, Length);
+        Clients [c].OutN += Length;
+      }
+    else if (Clients [c].Socket >= 0)
+      shutdown (Clients [c].Socket, SHUT_RDWR);
+    Unlock (&Clients [c].Queue);
+  }
+
+// Send what's queued for client c. Not with ServerLock held
+
+void ClientFlush (int c)
+  {
+    char Chunk [4096], *s;
+    int n, Length;
+    //
+    Lock (&Clients [c].Send);
+    while (true)
+      {
+        Lock (&Clients [c].Queue);
+        Length = Min (Clients [c].OutN, (int) sizeof (Chunk));
+        if (Length > 0)
+          {
+            memcpy (Chunk, Clients [c].Out, Length);
+            Clients [c].OutN -= Length;
+            MemMove (Clients [c].Out, Clients [c].Out + Length, Clients [c].OutN);
+          }
+        Unlock (&Clients [c].Queue);
+        if (Length <= 0)
+          break;
+        s = Chunk;
+        while (Clients [c].Socket >= 0 && Length > 0)
+          {
+            n = send (Clients [c].Socket, s, Length, MSG_NOSIGNAL);
+            if (n <= 0)
+              {
+                if (n < 0 && errno == EINTR)
+                  continue;
+                shutdown (Clients [c].Socket, SHUT_RDWR);   // gone, or not reading. The main loop will see it close
+                break;
+              }
+            s += n;
+            Length -= n;
+          }
+      }
+    Unlock (&Clients [c].Send);
+  }
+
+void LatencyAdd (_Latency *L, int ms)
+  {
+    L->Samples [L->N % LatencyN] = ms;
+    L->N++;
+  }
+
+// Percentile p (0..100) of the samples kept
+
+int LatencyPercentile (_Latency *L, int p)
+  {
+    int s [LatencyN];
+    int n, i, j, v;
+    //
+    n = Min (L->N, LatencyN);
+    if (n == 0)
+      return 0;
+    for (i = 0; i < n; i++)   // insertion sort, it's small
+      {
+        v = L->Samples [i];
+        for (j = i; j > 0 && s [j - 1] > v; j--)
+          s [j] = s [j - 1];
+        s [j] = v;
+      }
+    return s [Min ((n * p) / 100, n - 1)];
+  }
+
+// Text for "over <id> ..." if the side to move on the Board has no moves, else empty
+
+void GameOverLine (int ID, bool PlayWhite, char *Line)
+  {
+    _Move Moves [MovesMax];
+    int Checkers;
+    //
+    Line [0] = 0;
+    if (GetLegalMoves (PlayWhite, Moves, &Checkers) == 0)
+      sprintf (Line, "over %d %s\n", ID, (Checkers > 0) ? "checkmate" : "stalemate");
+  }
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Workers: take a game from the queue, search it one depth deeper, and put it back or reply
+//
+
+void QueueAdd (int g)
+  {
+    Queue [(QueueHead + QueueN) % GamesMax] = g;
+    QueueN++;
+    SignalWake (&ServerWork);
+  }
+
+// The engine to move in game g. ServerLock held
+
+void GameGo (int g)
+  {
+    Games [g].State = gsQueued;
+    Games [g].Iteration = -1;
+    Games [g].LastTime = 0;
+    Games [g].Start = ClockMS ();
+    QueueAdd (g);
+  }
+
+void ServerWorker (void *Param)
+  {
+    _Game *Game;
+    int g, c, Time, Score, Elapsed;
+    bool PlayWhite, Done;
+    char Line [LineMax], Over [LineMax];
+    _SpecialMove sm;
+    //
+    Lock (&ServerLock);
+    while (true)
+      {
+        while (QueueN == 0)
+          SignalWait (&ServerWork, &ServerLock);
+        g = Queue [QueueHead];
+        QueueHead = (QueueHead + 1) % GamesMax;
+        QueueN--;
+        Game = &Games [g];
+        if (Game->Ended)   // its client went while it waited
+          {
+            Game->State = gsFree;
+            continue;
+          }
+        Game->State = gsSearching;
+        Searching++;
+        MemMove (Board, Game->Board, sizeof (Board));
+        MoveID = Game->MoveID;
+        PlayWhite = Game->WhiteToMove;
+        DepthPlay = Game->Iteration + 1;
+        Unlock (&ServerLock);
+        // One more depth
+        Time = ClockMS ();
+        Score = BestMove (PlayWhite, 0);
+        Time = ClockMS () - Time;
+        Lock (&ServerLock);
+        Searching--;
+        if (Game->Ended)
+          {
+            Game->State = gsFree;
+            continue;
+          }
+        Game->Iteration = DepthPlay;
+        Game->Best.From = BestA [0];
+        Game->Best.To = BestB [0];
+        Game->Score = Score;
+        // Deeper costs about 8 times as much, or as the last depth grew
+        Elapsed = ClockMS () - Game->Start;
+        Done = Game->Iteration >= Game->Depth || RootMovesN <= 1 || ScoreMate (Score)
+               || Elapsed + Time * Max (8, Time / Max (Game->LastTime, 1)) > Game->Budget;
+        Game->LastTime = Time;
+        if (!Done)
+          {
+            Game->State = gsQueued;
+            QueueAdd (g);
+            continue;
+          }
+        // Play the move, on this thread's Board, and reply
+        sm = MovePiece (Game->Best.From, Game->Best.To);
+        InCheck (!PlayWhite);
+        MemMove (Game->Board, Board, sizeof (Board));
+        Game->MoveID = MoveID;
+        Game->WhiteToMove = !PlayWhite;
+        Game->State = gsIdle;
+        Game->Moves++;
+        Elapsed = ClockMS () - Game->Start;
+        LatencyAdd (&Game->Latency, Elapsed);
+        LatencyAdd (&LatencyAll, Elapsed);
+        sprintf (Line, "move %d %c%c%c%c%s score %d depth %d ms %d\n", Game->ID,
+                 Game->Best.From.x + 'a', Game->Best.From.y + '1', Game->Best.To.x + 'a', Game->Best.To.y + '1',
+                 (sm == smCrown) ? "q" : "", Score, Game->Iteration, Elapsed);
+        GameOverLine (Game->ID, !PlayWhite, Over);
+        c = Game->Client;
+        ClientSend (c, Line);
+        if (Over [0])
+          ClientSend (c, Over);
+        Unlock (&ServerLock);
+        ClientFlush (c);
+        Lock (&ServerLock);
+      }
+  }
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Commands. All with ServerLock held. Their replies are queued, for the main loop to send
+//
+
+// The game with this ID, and owned by client c, or -1
+
+int GameFind (int c, const char **s)
+  {
+    int ID, g;
+    //
+    ID = strtol (*s, (char **) s, 10);
+    for (g = 0; g < GamesMax; g++)
+      if (Games [g].State != gsFree && !Games [g].Ended && Games [g].ID == ID && Games [g].Client == c)
+        return g;
+    return -1;
+  }
+
+// Load game g into this thread's Board
+
+void GameLoad (int g)
+  {
+    MemMove (Board, Games [g].Board, sizeof (Board));
+    MoveID = Games [g].MoveID;
+  }
+
+void GameSave (int g)
+  {
+    MemMove (Games [g].Board, Board, sizeof (Board));
+    Games [g].MoveID = MoveID;
+  }
+
+// Engine to move in g, unless the game is over
+
+void CommandGo (int c, int g)
+  {
+    char Over [LineMax];
+    //
+    GameLoad (g);
+    Games [g].HumanWhite = !Games [g].WhiteToMove;
+    GameOverLine (Games [g].ID, Games [g].WhiteToMove, Over);
+    if (Over [0])
+      ClientSend (c, Over);
+    else
+      GameGo (g);
+  }
+
+bool StrGetPos (const char **s, _Coord *Pos)
+  {
+    if ((*s) [0] < 'a' || (*s) [0] > 'h' || (*s) [1] < '1' || (*s) [1] > '8')
+      return false;
+    Pos->x = (*s) [0] - 'a';
+    Pos->y = (*s) [1] - '1';
+    *s += 2;
+    return true;
+  }
+
+void Command (int c, const char *s)
+  {
+    char Line [LineMax];
+    const char *t;
+    _Coord From, To;
+    bool PlayWhite;
+    int g, i, n;
+    //
+    while (*s == ' ')
+      s++;
+    if (strncmp (s, "new", 3) == 0)
+      {
+        for (g = 0; g < GamesMax && Games [g].State != gsFree; g++)
+          ;
+        if (g >= GamesMax)
+          {
+            ClientSend (c, "error too many games\n");
+            return;
+          }
+        s += 3;
+        while (*s == ' ')
+          s++;
+        Games [g].HumanWhite = (*s != 'b');
+        if (*s)
+          s++;
+        Games [g].Depth = strtol (s, (char **) &s, 10);
+        Games [g].Budget = strtol (s, (char **) &s, 10);
+        if (Games [g].Depth <= 0)
+          Games [g].Depth = 8;
+        Games [g].Depth = Min (Games [g].Depth, DepthMax - 1);
+        if (Games [g].Budget <= 0)
+          Games [g].Budget = 1000;
+        Games [g].State = gsIdle;
+        Games [g].ID = GameNextID++;
+        Games [g].Client = c;
+        Games [g].Ended = false;
+        Games [g].Moves = 0;
+        Games [g].Latency.N = 0;
+        Games [g].WhiteToMove = true;
+        BoardInit ();
+        GameSave (g);
+        sprintf (Line, "game %d\n", Games [g].ID);
+        ClientSend (c, Line);
+        if (!Games [g].HumanWhite)
+          CommandGo (c, g);
+        return;
+      }
+    if (strncmp (s, "stats", 5) == 0)
+      {
+        n = 0;
+        for (g = 0; g < GamesMax; g++)
+          n += (Games [g].State != gsFree);
+        sprintf (Line, "stats games %d queue %d searching %d workers %d p50 %d p90 %d p99 %d\n", n, QueueN, Searching, Workers,
+                 LatencyPercentile (&LatencyAll, 50), LatencyPercentile (&LatencyAll, 90), LatencyPercentile (&LatencyAll, 99));
+        ClientSend (c, Line);
+        for (g = 0; g < GamesMax; g++)
+          if (Games [g].State != gsFree && !Games [g].Ended)
+            {
+              sprintf (Line, "game %d moves %d p50 %d p90 %d p99 %d\n", Games [g].ID, Games [g].Moves, LatencyPercentile (&Games [g].Latency, 50),
+                       LatencyPercentile (&Games [g].Latency, 90), LatencyPercentile (&Games [g].Latency, 99));
+              ClientSend (c, Line);
+            }
+        ClientSend (c, "ok\n");
+        return;
+      }
+    // The rest are for a game
+    for (t = s; *t && *t != ' '; t++)
+      ;
+    g = GameFind (c, &t);
+    while (*t == ' ')
+      t++;
+    if (g < 0)
+      ClientSend (c, "error no such game\n");
+    else if (strncmp (s, "end", 3) == 0)
+      {
+        if (Games [g].State == gsSearching)
+          Games [g].Ended = true;
+        else
+          {
+            if (Games [g].State == gsQueued)   // take it out of the queue
+              for (i = 0; i < QueueN; i++)
+                if (Queue [(QueueHead + i) % GamesMax] == g)
+                  {
+                    for (; i < QueueN - 1; i++)
+                      Queue [(QueueHead + i) % GamesMax] = Queue [(QueueHead + i + 1) % GamesMax];
+                    QueueN--;
+                    break;
+                  }
+            Games [g].State = gsFree;
+          }
+        ClientSend (c, "ok\n");
+      }
+    else if (Games [g].State != gsIdle)
+      ClientSend (c, "error busy\n");
+    else if (strncmp (s, "fen", 3) == 0)
+      {
+        if (!BoardFromFEN (t, &PlayWhite))
+          ClientSend (c, "error bad FEN\n");
+        else
+          {
+            InCheck (PlayWhite);
+            GameSave (g);
+            Games [g].WhiteToMove = PlayWhite;
+            ClientSend (c, "ok\n");
+            if (PlayWhite != Games [g].HumanWhite)
+              CommandGo (c, g);
+          }
+      }
+    else if (strncmp (s, "move", 4) == 0)
+      {
+        GameLoad (g);
+        if (!StrGetPos (&t, &From) || !StrGetPos (&t, &To))
+          ClientSend (c, "error bad move\n");
+        else if (Games [g].WhiteToMove != Games [g].HumanWhite)
+          ClientSend (c, "error not your move\n");
+        else if (Piece (Board [From.x][From.y]) == pEmpty || PieceWhite (Board [From.x][From.y]) != Games [g].HumanWhite || !MoveLegal (From, To))
+          ClientSend (c, "error illegal move\n");
+        else
+          {
+            MovePiece (From, To);
+            InCheck (!Games [g].HumanWhite);
+            GameSave (g);
+            Games [g].WhiteToMove = !Games [g].HumanWhite;
+            ClientSend (c, "ok\n");
+            CommandGo (c, g);
+          }
+      }
+    else if (strncmp (s, "go", 2) == 0)
+      CommandGo (c, g);
+    else
+      ClientSend (c, "error unknown command\n");
+  }
+
+// Client c has gone. End its games
+
+void ClientClose (int c)
+  {
+    int g;
+    //
+    Lock (&ServerLock);
+    for (g = 0; g < GamesMax; g++)
+      if (Games [g].State != gsFree && Games [g].Client == c)
+        if (Games [g].State == gsSearching || Games [g].State == gsQueued)
+          Games [g].Ended = true;   // the worker frees it
+        else
+          Games [g].State = gsFree;
+    Unlock (&ServerLock);
+    Lock (&Clients [c].Send);
+    Lock (&Clients [c].Queue);
+    close (Clients [c].Socket);
+    Clients [c].Socket = -1;
+    Clients [c].OutN = 0;
+    Unlock (&Clients [c].Queue);
+    Unlock (&Clients [c].Send);
+  }
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Main
+//
+
+int main (int argc, char *argv [])
+  {
+    const char *Path, *TablebaseDir;
+    struct sockaddr_un Address;
+    struct pollfd Poll [ClientsMax + 1];
+    int PollClient [ClientsMax + 1];
+    int Listen, Socket, c, i, n, Polls;
+    struct timeval SendTimeout = {ClientTimeout, 0};
+    _Thread Thread;
+    char *Line, *nl;
+    //
+    Path = "/tmp/chess.sock";
+    TablebaseDir = NULL;
+    Workers = ThreadCount ();
+    for (i = 1; i < argc; i++)
+      if (strcmp (argv [i], "Threads") == 0 && i + 1 < argc)
+        {
+          Workers = atoi (argv [++i]);
+          Workers = Max (Workers, 1);
+        }
+      else if (strcmp (argv [i], "Tb") == 0 && i + 1 < argc)
+        TablebaseDir = argv [++i];
+      else
+        Path = argv [i];
+    signal (SIGPIPE, SIG_IGN);
+    if (!BitbaseInit ())
+      fprintf (stderr, "** Can't build the bitbases\n");
+    TablebaseInit ();
+    if (TablebaseDir != NULL)
+      printf ("%d tablebases in %s\n", TablebaseOpen (TablebaseDir), TablebaseDir);
+    LockInit (&ServerLock);
+    SignalInit (&ServerWork);
+    for (c = 0; c < ClientsMax; c++)
+      {
+        Clients [c].Socket = -1;
+        Clients [c].OutN = 0;
+        LockInit (&Clients [c].Send);
+        LockInit (&Clients [c].Queue);
+      }
+    // Listen
+    Listen = socket (AF_UNIX, SOCK_STREAM, 0);
+    Address.sun_family = AF_UNIX;
+    strncpy (Address.sun_path, Path, sizeof (Address.sun_path) - 1);
+    Address.sun_path [sizeof (Address.sun_path) - 1] = 0;
+    unlink (Path);
+    if (Listen < 0 || bind (Listen, (struct sockaddr *) &Address, sizeof (Address)) < 0 || listen (Listen, 16) < 0)
+      {
+        fprintf (stderr, "** Can't listen on %s\n", Path);
+        return 1;
+      }
+    for (i = 0; i < Workers; i++)
+      if (!ThreadStart (&Thread, ServerWorker, NULL))
+        {
+          fprintf (stderr, "** Can't start workers\n");
+          return 1;
+        }
+    printf ("%s %s on %s, %d workers\n", AppName, Revision, Path, Workers);
+    fflush (stdout);
+    // Read commands
+    while (true)
+      {
+        Polls = 0;
+        Poll [Polls].fd = Listen;
+        Poll [Polls].events = POLLIN;
+        Polls++;
+        for (c = 0; c < ClientsMax; c++)
+          if (Clients [c].Socket >= 0)
+            {
+              Poll [Polls].fd = Clients [c].Socket;
+              Poll [Polls].events = POLLIN;
+              PollClient [Polls] = c;
+              Polls++;
+            }
+        if (poll (Poll, Polls, -1) < 0)
+          continue;
+        if (Poll [0].revents & POLLIN)
+          {
+            Socket = accept (Listen, NULL, NULL);
+            for (c = 0; c < ClientsMax && Clients [c].Socket >= 0; c++)
+              ;
+            if (Socket >= 0 && c >= ClientsMax)
+              close (Socket);
+            else if (Socket >= 0)
+              {
+                setsockopt (Socket, SOL_SOCKET, SO_SNDTIMEO, &SendTimeout, sizeof (SendTimeout));
+                Clients [c].InN = 0;
+                Clients [c].Socket = Socket;
+              }
+          }
+        for (i = 1; i < Polls; i++)
+          if (Poll [i].revents)
+            {
+              c = PollClient [i];
+              n = recv (Clients [c].Socket, Clients [c].In + Clients [c].InN, LineMax - 1 - Clients [c].InN, 0);
+              if (n <= 0)
+                {
+                  ClientClose (c);
+                  continue;
+                }
+              Clients [c].InN += n;
+              Clients [c].In [Clients [c].InN] = 0;
+              Line = Clients [c].In;
+              while ((nl = strchr (Line, '\n')) != NULL)
+                {
+                  *nl = 0;
+                  if (nl > Line && nl [-1] == '\r')
+                    nl [-1] = 0;
+                  Lock (&ServerLock);
+                  Command (c, Line);
+                  Unlock (&ServerLock);
+                  ClientFlush (c);
+                  Line = nl + 1;
+                }
+              Clients [c].InN -= Line - Clients [c].In;
+              MemMove (Clients [c].In, Line, Clients [c].InN);
+              if (Clients [c].InN >= LineMax - 1)   // too long, drop it
+                Clients [c].InN = 0;
+            }
+      }
+    return 0;
+  }
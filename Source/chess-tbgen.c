@@ -0,0 +1,390 @@
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// CHESS TABLEBASE GENERATOR
+// =========================
+//
+// Author: Stewart Tunbridge, Pi Micros
+// Email:  stewarttunbridge@gmail.com
+// Copyright (c) 2025 Stewart Tunbridge, Pi Micros
+//
+// Build distance to mate tables for endings of up to 5 pieces, for chess-con Tb <dir>
+//
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// Retrograde analysis with the engine's own move rules: each position is set up on the Board and
+// its moves made with GetLegalMoves and MovePiece. Every position starts as a draw. Pass 0 finds
+// the mates. Then pass k settles the positions k plies from mate:
+//   - a win if any move reaches a position lost in k - 1 plies
+//   - a loss if every move reaches a position won in at most k - 1 plies
+// Only values from earlier passes are used, so a pass can be split between threads by index range
+// and give the same table however many there are. What is left at the end is a draw.
+//
+// A capture or a Pawn crowning leads to a smaller table. Those are loaded from Dir if there, else
+// built (and written) first. A Pawn only crowns to a Queen, as MovePiece does. En passant isn't
+// modelled: a table's positions have no last move, so none is possible in them, and Recognise
+// doesn't probe a position where one is.
+//
+// Parameters: chess-tbgen [Threads <n>] [Dir <dir>] <table> ...   eg chess-tbgen KQKR KRPKR
+//
+/////////////////////////////////////////////////////////////////////////////////////
+
+
+const char AppName [] = "Chess Tablebase Generator";
+const char Revision [] = "1.00";
+
+#include "../Lib/Lib.c"
+#include "Thread.c"
+#include "Trace.c"
+#include "FileMap.c"
+#include "Bitbase.c"
+#include "Tablebase.c"
+#include "Chess.c"
+
+int Threads;
+const char *Dir;
+longint Memory, MemoryPeak;   // bytes of tables in memory
+
+void MemoryAdd (longint Bytes)
+  {
+    Memory += Bytes;
+    MemoryPeak = Max (MemoryPeak, Memory);
+  }
+
+// Set up the Board with a position. Every piece has moved, so there's no castling
+
+void TbBoard (const _Tablebase *t, const int *Sq)
+  {
+    int i, x, y;
+    //
+    for (x = 0; x < 8; x++)
+      for (y = 0; y < 8; y++)
+        Board [x][y] = pEmpty;
+    for (i = 0; i < t->n; i++)
+      Board [tbX (Sq [i])][tbY (Sq [i])] = (_Piece) (PieceFrom (pKing + (strchr (TablebaseKinds, t->Kind [i]) - TablebaseKinds), i < t->Whites) | pMoveID);
+    MoveID = 1;
+  }
+
+// The value after a move, for the side to move then. Sq is the position before it
+
+int TbChild (_Tablebase *t, bool WhiteToMove, const int *Sq, _Move *m)
+  {
+    char Pce [TablebasePiecesMax];
+    int To [TablebasePiecesMax], i, n, v;
+    _Piece OldFrom, OldTo, p;
+    _SpecialMove sm;
+    _Coord At;
+    //
+    OldFrom = Board [m->From.x][m->From.y];
+    OldTo = Board [m->To.x][m->To.y];
+    if (Piece (OldTo) == pEmpty && !(Piece (OldFrom) == pPawn && m->To.y == LastRow [WhiteToMove]))   // stays in this table
+      {
+        for (i = 0; i < t->n; i++)
+          To [i] = (Sq [i] == m->From.y * 8 + m->From.x) ? m->To.y * 8 + m->To.x : Sq [i];
+        return TablebaseValue (t, TablebaseIndex (t, !WhiteToMove, To));
+      }
+    sm = MovePiece (m->From, m->To);
+    n = 0;
+    for (At.y = 0; At.y < 8; At.y++)
+      for (At.x = 0; At.x < 8; At.x++)
+        {
+          p = Board [At.x][At.y];
+          if (Piece (p) != pEmpty)
+            {
+              Pce [n] = TablebaseKinds [Piece (p) - pKing] + (PieceWhite (p) ? 0 : 'a' - 'A');
+              To [n++] = At.y * 8 + At.x;
+            }
+        }
+    UnmovePiece (m->From, m->To, OldFrom, OldTo, sm);
+    v = TablebaseProbe (n, Pce, To, !WhiteToMove);
+    return (v < 0) ? tvDraw : v;   // no table: bare Kings, or a lone minor piece
+  }
+
+// One thread's share of a pass
+
+typedef struct
+  {
+    _Tablebase *t;
+    longint From, To;
+    int Pass;
+    longint Changed;
+  } _TbSlice;
+
+void TbPass (void *Param)
+  {
+    _TbSlice *Slice;
+    _Tablebase *t;
+    _Move Moves [MovesMax];
+    _Coord King;
+    int Sq [TablebasePiecesMax], n, Checkers, i, j, v, Result;
+    bool WhiteToMove, Lost;
+    longint Index;
+    //
+    Slice = (_TbSlice *) Param;
+    t = Slice->t;
+    Slice->Changed = 0;
+    for (Index = Slice->From; Index < Slice->To; Index++)
+      {
+        if (t->Data [Index] != tvDraw)   // settled
+          continue;
+        TablebasePosition (t, Index, &WhiteToMove, Sq);
+        if (Slice->Pass == 0)
+          {
+            for (i = 0; i < t->n; i++)
+              for (j = 0; j < i; j++)
+                if (Sq [i] == Sq [j])
+                  t->Data [Index] = tvIllegal;
+            if (t->Data [Index] == tvIllegal)
+              continue;
+          }
+        TbBoard (t, Sq);
+        if (Slice->Pass == 0)
+          {
+            King.x = tbX (Sq [WhiteToMove ? t->Whites : 0]);
+            King.y = tbY (Sq [WhiteToMove ? t->Whites : 0]);
+            if (SquareAttacked (King, WhiteToMove))   // the side not to move is in check
+              {
+                t->Data [Index] = tvIllegal;
+                continue;
+              }
+          }
+        n = GetLegalMoves (WhiteToMove, Moves, &Checkers);
+        Result = tvDraw;
+        if (Slice->Pass == 0)
+          {
+            if (n == 0 && Checkers > 0)
+              Result = 1;   // mated
+          }
+        else
+          {
+            Lost = (n > 0);
+            for (i = 0; i < n; i++)
+              {
+                v = TbChild (t, WhiteToMove, Sq, &Moves [i]);
+                if (v == tvDraw || v > Slice->Pass)   // not settled before this pass
+                  Lost = false;
+                else if (!TablebaseMates (v))   // they're mated
+                  {
+                    Result = Slice->Pass + 1;
+                    break;
+                  }
+              }
+            if (Lost)
+              Result = Slice->Pass + 1;
+          }
+        if (Result != tvDraw)
+          {
+            __atomic_store_n (&t->Data [Index], (unsigned char) Result, __ATOMIC_RELAXED);
+            Slice->Changed++;
+          }
+      }
+  }
+
+_Tablebase *TbBuild (const char *Name);
+
+// Make sure the table for a material (letters, White's in capitals) is there: loaded from Dir,
+// else built. t is set NULL if it's one without a table. Returns false if it can't be had, as
+// then the captures into it would be scored as draws
+
+bool TbNeed (const char *Pce, int n, _Tablebase **t)
+  {
+    char Name [8], FileName [1024];
+    bool Swap;
+    //
+    *t = NULL;
+    if (!TablebaseName (Pce, n, Name, &Swap))
+      return false;
+    if (n <= 3 && strpbrk (Name, "QRP") == NULL)   // KK, KBK, KNK: all draws
+      return true;
+    *t = TablebaseFind (Name);
+    if (*t != NULL)
+      return true;
+    snprintf (FileName, sizeof (FileName), "%s/%s.ctb", Dir, Name);
+    *t = TablebaseLoad (Name, FileName, true);
+    if (*t == NULL)
+      *t = TbBuild (Name);
+    else
+      {
+        MemoryAdd ((*t)->Size);
+        printf ("%-6s loaded from %s\n", Name, FileName);
+      }
+    return *t != NULL;
+  }
+
+// The material of t with piece Taken gone and Pawn Crowned a Queen (-1 => none), as letters
+
+int TbMaterial (const _Tablebase *t, int Taken, int Crowned, char *Pce)
+  {
+    int i, n;
+    //
+    n = 0;
+    for (i = 0; i < t->n; i++)
+      if (i != Taken)
+        {
+          Pce [n] = (i == Crowned) ? 'Q' : t->Kind [i];
+          if (i >= t->Whites)
+            Pce [n] += 'a' - 'A';
+          n++;
+        }
+    return n;
+  }
+
+// The highest value in a table
+
+int TbLongest (const _Tablebase *t)
+  {
+    longint Index;
+    int Longest;
+    //
+    Longest = 0;
+    if (t != NULL)
+      for (Index = 0; Index < t->Size; Index++)
+        if (t->Data [Index] != tvIllegal)
+          Longest = Max (Longest, t->Data [Index]);
+    return Longest;
+  }
+
+_Tablebase *TbBuild (const char *Name)
+  {
+    _Tablebase Material, *t, *Sub;
+    _TbSlice Slices [256];
+    char Pce [TablebasePiecesMax], FileName [1024];
+    int i, j, n, Pass, Longest, Settled, Time;
+    longint Index, Changed, Legal, Won, Lost, Bytes;
+    bool OK;
+    //
+    if (TablebasesN >= TablebasesMax || !TablebaseSetup (&Material, Name))
+      {
+        printf ("** %s isn't a table\n", Name);
+        return NULL;
+      }
+    // First the tables its captures and crownings lead to. Passes go on at least as far as their
+    // longest mate
+    Settled = 0;
+    OK = true;
+    for (i = 0; OK && i < Material.n; i++)
+      if (Material.Kind [i] != 'K')
+        {
+          n = TbMaterial (&Material, i, -1, Pce);
+          OK = TbNeed (Pce, n, &Sub);
+          Settled = Max (Settled, TbLongest (Sub));
+          if (OK && Material.Kind [i] == 'P')
+            {
+              n = TbMaterial (&Material, -1, i, Pce);
+              OK = TbNeed (Pce, n, &Sub);
+              Settled = Max (Settled, TbLongest (Sub));
+              for (j = 0; OK && j < Material.n; j++)
+                if (Material.Kind [j] != 'K' && (j < Material.Whites) != (i < Material.Whites))
+                  {
+                    n = TbMaterial (&Material, j, i, Pce);
+                    OK = TbNeed (Pce, n, &Sub);
+                    Settled = Max (Settled, TbLongest (Sub));
+                  }
+            }
+        }
+    if (!OK)
+      {
+        printf ("** Can't build %s without the tables it leads to\n", Name);
+        return NULL;
+      }
+    // Then this one
+    t = &Tablebases [TablebasesN];
+    if (TablebasesN >= TablebasesMax || !TablebaseSetup (t, Name) || (t->Data = (unsigned char *) malloc (t->Size)) == NULL)
+      {
+        printf ("** No room for %s\n", Name);
+        return NULL;
+      }
+    TablebasesN++;
+    MemoryAdd (t->Size);
+    memset (t->Data, tvDraw, t->Size);
+    Time = ClockMS ();
+    for (i = 0; i < Threads; i++)
+      {
+        Slices [i].t = t;
+        Slices [i].From = t->Size * i / Threads;
+        Slices [i].To = t->Size * (i + 1) / Threads;
+      }
+    for (Pass = 0; Pass < tvIllegal - 1; Pass++)
+      {
+        for (i = 0; i < Threads; i++)
+          Slices [i].Pass = Pass;
+        ThreadsParallel (TbPass, Slices, sizeof (_TbSlice), Threads);
+        Changed = 0;
+        for (i = 0; i < Threads; i++)
+          Changed += Slices [i].Changed;
+        if (Pass > 0 && Changed == 0 && Pass >= Settled)
+          break;
+      }
+    Time = ClockMS () - Time;
+    // Report
+    Legal = Won = Lost = 0;
+    Longest = 0;
+    for (Index = 0; Index < t->Size; Index++)
+      if (t->Data [Index] != tvIllegal)
+        {
+          Legal++;
+          if (t->Data [Index] != tvDraw)
+            {
+              if (TablebaseMates (t->Data [Index]))
+                Won++;
+              else
+                Lost++;
+              Longest = Max (Longest, TablebasePlies (t->Data [Index]));
+            }
+        }
+    snprintf (FileName, sizeof (FileName), "%s/%s.ctb", Dir, Name);
+    Bytes = TablebaseWrite (t, FileName);
+    printf ("%-6s %lld positions, %lld legal: %.1f%% won, %.1f%% lost, %.1f%% drawn by the side to move. Longest mate %d moves\n",
+            Name, t->Size, Legal, 100.0 * Won / Max (Legal, 1), 100.0 * Lost / Max (Legal, 1), 100.0 * (Legal - Won - Lost) / Max (Legal, 1), (Longest + 1) / 2);
+    printf ("       %d passes in %.1fs, %d threads. Peak memory %.1fMB. ", Pass + 1, Time / 1000.0, Threads, MemoryPeak / 1e6);
+    if (Bytes > 0)
+      printf ("%s %lld bytes, %.1f%%\n", FileName, Bytes, 100.0 * Bytes / t->Size);
+    else
+      printf ("** Can't write %s\n", FileName);
+    fflush (stdout);
+    return t;
+  }
+
+int main (int argc, char *argv [])
+  {
+    char Pce [TablebasePiecesMax + 1], Name [8];
+    int i, j, n, k;
+    bool Swap;
+    //
+    Threads = Min (ThreadCount (), 256);   // TbBuild's slices
+    Dir = ".";
+    Memory = MemoryPeak = 0;
+    TablebaseInit ();
+    n = 0;
+    for (i = 1; i < argc; i++)
+      if (strcmp (argv [i], "Threads") == 0 && i + 1 < argc)
+        Threads = Min (Max (atoi (argv [++i]), 1), 256);
+      else if (strcmp (argv [i], "Dir") == 0 && i + 1 < argc)
+        Dir = argv [++i];
+      else
+        {
+          // White's pieces up to Black's King, eg KRPKR
+          k = StrLength (argv [i]);
+          Name [0] = 0;
+          if (k <= TablebasePiecesMax && argv [i][0] == 'K' && strrchr (argv [i], 'K') != argv [i])
+            {
+              for (j = 0; j < k; j++)
+                Pce [j] = (argv [i] + j < strrchr (argv [i], 'K')) ? UpCase (argv [i][j]) : UpCase (argv [i][j]) - 'A' + 'a';
+              if (!TablebaseName (Pce, k, Name, &Swap))
+                Name [0] = 0;
+            }
+          if (Name [0] == 0)
+            {
+              printf ("** %s isn't a table. Eg KQKR, KRPKR: White's pieces then Black's, up to %d\n", argv [i], TablebasePiecesMax);
+              return 1;
+            }
+          if (TablebaseFind (Name) == NULL)
+            TbBuild (Name);
+          n++;
+        }
+    if (n == 0)
+      {
+        printf ("Use: chess-tbgen [Threads <n>] [Dir <dir>] <table> ...   eg chess-tbgen KQKR KRPKR\n");
+        return 1;
+      }
+    return 0;
+  }
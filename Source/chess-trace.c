@@ -0,0 +1,164 @@
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// CHESS TRACE
+// ===========
+//
+// Author: Stewart Tunbridge, Pi Micros
+// Email:  stewarttunbridge@gmail.com
+// Copyright (c) 2025 Stewart Tunbridge, Pi Micros
+//
+// Summarise a search trace written by chess-con Trace <file> (built with -DTRACE)
+//
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// Shows
+//   - per ply: moves searched, cut offs, how often the first move cut off, and the branching
+//     factor (moves at the next ply per move searched below)
+//   - the largest subtrees, with the line to them
+//   - the work thrown away: moves searched before the move that cut off, and each iterative
+//     deepening search that was followed by a deeper one
+//
+// Parameters: chess-trace <file> [<n largest subtrees>]
+//
+/////////////////////////////////////////////////////////////////////////////////////
+
+
+const char AppName [] = "Chess Trace";
+const char Revision [] = "1.01";
+
+#include "../Lib/Lib.c"
+#include "Thread.c"
+#include "Trace.c"
+#include "FileMap.c"
+
+#define PlyMax 256
+#define LargestMax 100
+
+typedef struct
+  {
+    longint Moves, Cutoffs, FirstCutoffs;
+    longint Inner;   // moves with a search below them
+    longint Siblings, SiblingNodes;   // so far under the current parent
+  } _Ply;
+
+_Ply Plies [PlyMax];
+
+void PutMove (const _TraceRecord *r)
+  {
+    printf ("%c%c%c%c", 'a' + r->From % 8, '1' + r->From / 8, 'a' + r->To % 8, '1' + r->To / 8);
+  }
+
+double Percent (longint a, longint b)
+  {
+    return (b > 0) ? 100.0 * a / b : 0.0;
+  }
+
+int main (int argc, char *argv [])
+  {
+    _FileMap Map;
+    const _TraceHeader *Header;
+    const _TraceRecord *r, *Records;
+    longint n, i, j, Searches, Nodes, Wasted, Researched, PrevNodes;
+    int Largest [LargestMax], LargestN, LargestMaxN, Line [PlyMax];
+    int p, k, l, PrevDepth;
+    //
+    if (argc < 2)
+      {
+        printf ("Use: chess-trace <trace file> [<n largest subtrees>]\n");
+        return 1;
+      }
+    LargestMaxN = 10;
+    if (argc > 2)
+      LargestMaxN = Min (Max (atoi (argv [2]), 1), LargestMax);
+    Header = NULL;
+    if (FileMapOpen (argv [1], &Map) && Map.Size >= (longint) sizeof (_TraceHeader))
+      Header = (const _TraceHeader *) Map.Data;
+    if (Header == NULL || Header->Magic != TraceMagic || Header->RecordSize != sizeof (_TraceRecord))
+      {
+        printf ("** %s isn't a trace file\n", argv [1]);
+        return 1;
+      }
+    Records = (const _TraceRecord *) (Map.Data + sizeof (_TraceHeader));
+    n = (Map.Size - sizeof (_TraceHeader)) / sizeof (_TraceRecord);
+    // One pass, in post order
+    Searches = 0;
+    Nodes = 0;
+    Wasted = 0;
+    Researched = 0;
+    PrevDepth = PlyMax;
+    PrevNodes = 0;
+    LargestN = 0;
+    for (i = 0; i < n; i++)
+      {
+        r = &Records [i];
+        if (r->Flags & tfSearch)
+          {
+            Searches++;
+            Nodes += r->Nodes;
+            if (r->Ply == PrevDepth + 1)   // the last was an iteration of this one
+              Researched += PrevNodes;
+            PrevDepth = r->Ply;
+            PrevNodes = r->Nodes;
+            for (p = 0; p < PlyMax; p++)
+              Plies [p].Siblings = Plies [p].SiblingNodes = 0;
+            continue;
+          }
+        p = r->Ply;
+        Plies [p].Moves++;
+        if (!(r->Flags & tfLeaf))
+          Plies [p].Inner++;
+        if (r->Flags & tfCutoff)
+          {
+            Plies [p].Cutoffs++;
+            if (Plies [p].Siblings == 0)
+              Plies [p].FirstCutoffs++;
+            Wasted += Plies [p].SiblingNodes;
+          }
+        Plies [p].Siblings++;
+        Plies [p].SiblingNodes += r->Nodes;
+        if (p + 1 < PlyMax)   // the moves below this one are done with
+          Plies [p + 1].Siblings = Plies [p + 1].SiblingNodes = 0;
+        // Keep the largest, biggest first
+        if (LargestN < LargestMaxN || r->Nodes > Records [Largest [LargestN - 1]].Nodes)
+          {
+            if (LargestN < LargestMaxN)
+              LargestN++;
+            for (k = LargestN - 1; k > 0 && Records [Largest [k - 1]].Nodes < r->Nodes; k--)
+              Largest [k] = Largest [k - 1];
+            Largest [k] = i;
+          }
+      }
+    // Report
+    printf ("%s: %lld Records, %lld Searches, %lld Moves searched\n\n", argv [1], n, Searches, Nodes);
+    printf ("Ply       Moves   Cut offs  First  Branching\n");
+    for (p = 0; p < PlyMax; p++)
+      if (Plies [p].Moves)
+        printf ("%3d %11lld %10lld %5.1f%% %10.2f\n", p, Plies [p].Moves, Plies [p].Cutoffs, Percent (Plies [p].FirstCutoffs, Plies [p].Cutoffs),
+                (p + 1 < PlyMax && Plies [p].Inner) ? (double) Plies [p + 1].Moves / Plies [p].Inner : 0.0);
+    printf ("\nLargest subtrees\n");
+    for (k = 0; k < LargestN; k++)
+      {
+        // Parents follow their children: the next record a ply up
+        r = &Records [Largest [k]];
+        l = 0;
+        Line [l++] = Largest [k];
+        for (j = Largest [k] + 1, p = r->Ply; p > 0 && j < n && !(Records [j].Flags & tfSearch); j++)
+          if (Records [j].Ply == p - 1)
+            {
+              Line [l++] = j;
+              p--;
+            }
+        printf ("%12lld  Ply %d  Score %d  Window %d %d  ", (longint) r->Nodes, r->Ply, r->Score, r->Alpha, r->Beta);
+        while (l > 0)
+          {
+            PutMove (&Records [Line [--l]]);
+            printf (" ");
+          }
+        printf ("\n");
+      }
+    printf ("\nWasted\n");
+    printf ("  Searched before the cut off move %12lld %5.1f%%\n", Wasted, Percent (Wasted, Nodes));
+    printf ("  Iterations deepened again        %12lld %5.1f%%\n", Researched, Percent (Researched, Nodes));
+    FileMapClose (&Map);
+    return 0;
+  }